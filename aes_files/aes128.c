@@ -0,0 +1,267 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#include <string.h>
+
+#include "aes128.h"
+
+
+uint8_t gf256_mult(uint8_t a, uint8_t b){
+	uint8_t res = 0;
+	for(int i = 0; i < 8; i++){
+		res ^= (uint8_t)(-(b & 1)) & a;
+		a = (a << 1) ^ ((uint8_t)(-(a >> 7)) & 0x1b);
+		b >>= 1;
+	}
+	return res;
+}
+
+
+uint8_t aes_sbox(uint8_t x){
+	// x^254 with the same addition chain as exp254_sharing
+	uint8_t x2 = gf256_mult(x, x);
+	uint8_t x4 = gf256_mult(x2, x2);
+	uint8_t x8 = gf256_mult(x4, x4);
+	uint8_t x9 = gf256_mult(x8, x);
+	uint8_t x18 = gf256_mult(x9, x9);
+	uint8_t x19 = gf256_mult(x18, x);
+	uint8_t x27 = gf256_mult(x19, x8);
+	uint8_t x54 = gf256_mult(x27, x27);
+	uint8_t x108 = gf256_mult(x54, x54);
+	uint8_t x127 = gf256_mult(x108, x19);
+	uint8_t y = gf256_mult(x127, x127);
+	
+	// affine function
+	return y ^ (uint8_t)((y << 1) | (y >> 7)) ^ (uint8_t)((y << 2) | (y >> 6))
+		^ (uint8_t)((y << 3) | (y >> 5)) ^ (uint8_t)((y << 4) | (y >> 4)) ^ 0x63;
+}
+
+
+void aes_key_expansion_128(const uint8_t * key, uint8_t * roundkeys){
+	uint8_t rcon = 1;
+	uint8_t tmp[4], u;
+	
+	memcpy(roundkeys, key, AES_BLOCK_SIZE);
+	for(int i = AES_BLOCK_SIZE; i < AES_ROUND_KEY_SIZE; i += 4){
+		memcpy(tmp, roundkeys + i - 4, 4);
+		if(i % AES_BLOCK_SIZE == 0){
+			// RotWord, SubWord and Rcon
+			u = tmp[0];
+			tmp[0] = aes_sbox(tmp[1]) ^ rcon;
+			tmp[1] = aes_sbox(tmp[2]);
+			tmp[2] = aes_sbox(tmp[3]);
+			tmp[3] = aes_sbox(u);
+			rcon = gf256_mult(rcon, 2);
+		}
+		for(int j = 0; j < 4; j++){
+			roundkeys[i + j] = roundkeys[i - AES_BLOCK_SIZE + j] ^ tmp[j];
+		}
+	}
+}
+
+
+uint8_t aes_inv_sbox(uint8_t x){
+	// inverse of the affine function, then x^254 (its own inverse)
+	uint8_t y = (uint8_t)((x << 1) | (x >> 7)) ^ (uint8_t)((x << 3) | (x >> 5))
+		^ (uint8_t)((x << 6) | (x >> 2)) ^ 0x05;
+	
+	uint8_t y2 = gf256_mult(y, y);
+	uint8_t y4 = gf256_mult(y2, y2);
+	uint8_t y8 = gf256_mult(y4, y4);
+	uint8_t y9 = gf256_mult(y8, y);
+	uint8_t y18 = gf256_mult(y9, y9);
+	uint8_t y19 = gf256_mult(y18, y);
+	uint8_t y27 = gf256_mult(y19, y8);
+	uint8_t y54 = gf256_mult(y27, y27);
+	uint8_t y108 = gf256_mult(y54, y54);
+	uint8_t y127 = gf256_mult(y108, y19);
+	return gf256_mult(y127, y127);
+}
+
+
+static void add_round_key(uint8_t * state, const uint8_t * roundkey){
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		state[i] ^= roundkey[i];
+	}
+}
+
+
+// SubBytes and ShiftRows (resp. their inverses) in one pass
+static void sub_shift(uint8_t * state){
+	uint8_t tmp[AES_BLOCK_SIZE];
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		tmp[i] = aes_sbox(state[(i + 4 * (i % 4)) % AES_BLOCK_SIZE]);
+	}
+	memcpy(state, tmp, AES_BLOCK_SIZE);
+}
+
+static void inv_sub_shift(uint8_t * state){
+	uint8_t tmp[AES_BLOCK_SIZE];
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		tmp[(i + 4 * (i % 4)) % AES_BLOCK_SIZE] = aes_inv_sbox(state[i]);
+	}
+	memcpy(state, tmp, AES_BLOCK_SIZE);
+}
+
+
+void aes_mix_columns(uint8_t * state){
+	uint8_t t, u;
+	for(int i = 0; i < AES_BLOCK_SIZE; i += 4){
+		t = state[i] ^ state[i+1] ^ state[i+2] ^ state[i+3];
+		u = state[i];
+		state[i]   ^= t ^ gf256_mult(2, state[i]   ^ state[i+1]);
+		state[i+1] ^= t ^ gf256_mult(2, state[i+1] ^ state[i+2]);
+		state[i+2] ^= t ^ gf256_mult(2, state[i+2] ^ state[i+3]);
+		state[i+3] ^= t ^ gf256_mult(2, state[i+3] ^ u);
+	}
+}
+
+
+void aes_inv_mix_columns(uint8_t * state){
+	uint8_t u, v;
+	// InvMixColumns = MixColumns o (4 x^2 + 5)
+	for(int i = 0; i < AES_BLOCK_SIZE; i += 4){
+		u = gf256_mult(4, state[i] ^ state[i+2]);
+		v = gf256_mult(4, state[i+1] ^ state[i+3]);
+		state[i] ^= u;
+		state[i+1] ^= v;
+		state[i+2] ^= u;
+		state[i+3] ^= v;
+	}
+	aes_mix_columns(state);
+}
+
+
+void aes_encrypt_128(const uint8_t * roundkeys, const uint8_t * in, uint8_t * out){
+	uint8_t state[AES_BLOCK_SIZE];
+	
+	memcpy(state, in, AES_BLOCK_SIZE);
+	add_round_key(state, roundkeys);
+	for(int r = 1; r < AES_ROUNDS; r++){
+		sub_shift(state);
+		aes_mix_columns(state);
+		add_round_key(state, roundkeys + r * AES_BLOCK_SIZE);
+	}
+	sub_shift(state);
+	add_round_key(state, roundkeys + AES_ROUNDS * AES_BLOCK_SIZE);
+	memcpy(out, state, AES_BLOCK_SIZE);
+}
+
+
+void aes_decrypt_128(const uint8_t * roundkeys, const uint8_t * in, uint8_t * out){
+	uint8_t state[AES_BLOCK_SIZE];
+	
+	memcpy(state, in, AES_BLOCK_SIZE);
+	add_round_key(state, roundkeys + AES_ROUNDS * AES_BLOCK_SIZE);
+	for(int r = AES_ROUNDS - 1; r > 0; r--){
+		inv_sub_shift(state);
+		add_round_key(state, roundkeys + r * AES_BLOCK_SIZE);
+		aes_inv_mix_columns(state);
+	}
+	inv_sub_shift(state);
+	add_round_key(state, roundkeys);
+	memcpy(out, state, AES_BLOCK_SIZE);
+}
+
+
+/*************************** AES-NI ***************************/
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+int aes_ni_available(void){
+	return __builtin_cpu_supports("aes");
+}
+
+__attribute__((target("aes,sse2")))
+static void encrypt_blocks_ni(const uint8_t * roundkeys, const uint8_t * in, uint8_t * out, size_t nb_blocks){
+	__m128i rk[AES_ROUNDS + 1], b;
+	for(int r = 0; r <= AES_ROUNDS; r++){
+		rk[r] = _mm_loadu_si128((const __m128i *)(roundkeys + r * AES_BLOCK_SIZE));
+	}
+	for(size_t j = 0; j < nb_blocks; j++){
+		b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + j * AES_BLOCK_SIZE)), rk[0]);
+		for(int r = 1; r < AES_ROUNDS; r++){
+			b = _mm_aesenc_si128(b, rk[r]);
+		}
+		b = _mm_aesenclast_si128(b, rk[AES_ROUNDS]);
+		_mm_storeu_si128((__m128i *)(out + j * AES_BLOCK_SIZE), b);
+	}
+}
+
+__attribute__((target("aes,sse2")))
+static void decrypt_blocks_ni(const uint8_t * roundkeys, const uint8_t * in, uint8_t * out, size_t nb_blocks){
+	// round keys of the equivalent inverse cipher, in the order of use
+	__m128i rk[AES_ROUNDS + 1], b;
+	rk[0] = _mm_loadu_si128((const __m128i *)(roundkeys + AES_ROUNDS * AES_BLOCK_SIZE));
+	for(int r = 1; r < AES_ROUNDS; r++){
+		rk[r] = _mm_aesimc_si128(_mm_loadu_si128((const __m128i *)(roundkeys + (AES_ROUNDS - r) * AES_BLOCK_SIZE)));
+	}
+	rk[AES_ROUNDS] = _mm_loadu_si128((const __m128i *)roundkeys);
+	for(size_t j = 0; j < nb_blocks; j++){
+		b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + j * AES_BLOCK_SIZE)), rk[0]);
+		for(int r = 1; r < AES_ROUNDS; r++){
+			b = _mm_aesdec_si128(b, rk[r]);
+		}
+		b = _mm_aesdeclast_si128(b, rk[AES_ROUNDS]);
+		_mm_storeu_si128((__m128i *)(out + j * AES_BLOCK_SIZE), b);
+	}
+}
+
+#else
+
+int aes_ni_available(void){
+	return 0;
+}
+
+#define encrypt_blocks_ni(roundkeys, in, out, nb_blocks)
+#define decrypt_blocks_ni(roundkeys, in, out, nb_blocks)
+
+#endif
+
+
+void aes_encrypt_128_blocks(const uint8_t * roundkeys, const uint8_t * in, uint8_t * out, size_t nb_blocks){
+	if(aes_ni_available()){
+		encrypt_blocks_ni(roundkeys, in, out, nb_blocks);
+		return;
+	}
+	for(size_t j = 0; j < nb_blocks; j++){
+		aes_encrypt_128(roundkeys, in + j * AES_BLOCK_SIZE, out + j * AES_BLOCK_SIZE);
+	}
+}
+
+
+void aes_decrypt_128_blocks(const uint8_t * roundkeys, const uint8_t * in, uint8_t * out, size_t nb_blocks){
+	if(aes_ni_available()){
+		decrypt_blocks_ni(roundkeys, in, out, nb_blocks);
+		return;
+	}
+	for(size_t j = 0; j < nb_blocks; j++){
+		aes_decrypt_128(roundkeys, in + j * AES_BLOCK_SIZE, out + j * AES_BLOCK_SIZE);
+	}
+}
@@ -0,0 +1,105 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#ifndef AES128_H
+#define AES128_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes128_sharing.h"
+
+/**********************************************************
+ * this file contains the unmasked AES-128 routines that
+ * are needed around the n-share implementation (the key
+ * expansion, whose result is then shared with 
+ * generate_n_sharing, and the reference cipher that the
+ * n-share results are checked and timed against). They 
+ * do not use any lookup table.
+**********************************************************/
+
+/**********************************************************
+ * Multiplication in GF(256) without lookup table
+**********************************************************/
+uint8_t gf256_mult(uint8_t a, uint8_t b);
+
+
+/**********************************************************
+ * AES S-box computed as the affine function of x^254
+**********************************************************/
+uint8_t aes_sbox(uint8_t x);
+
+uint8_t aes_inv_sbox(uint8_t x);
+
+
+/**********************************************************
+ * key : AES_BLOCK_SIZE byte key
+ * roundkeys : AES_ROUND_KEY_SIZE byte output
+ * Standard AES-128 key expansion
+**********************************************************/
+void aes_key_expansion_128(const uint8_t * key, uint8_t * roundkeys);
+
+
+/**********************************************************
+ * MixColumns (resp. its inverse) on the 16 bytes of state,
+ * in place
+**********************************************************/
+void aes_mix_columns(uint8_t * state);
+
+void aes_inv_mix_columns(uint8_t * state);
+
+
+/**********************************************************
+ * roundkeys : AES_ROUND_KEY_SIZE bytes, from 
+ * aes_key_expansion_128
+ * in, out : AES_BLOCK_SIZE bytes, out can be in
+ * Unmasked reference AES-128 on one block, with the 
+ * S-box computed by aes_sbox (slow, but without table)
+**********************************************************/
+void aes_encrypt_128(const uint8_t * roundkeys, const uint8_t * in, uint8_t * out);
+
+void aes_decrypt_128(const uint8_t * roundkeys, const uint8_t * in, uint8_t * out);
+
+
+/**********************************************************
+ * 1 when the CPU has the AES-NI instructions
+**********************************************************/
+int aes_ni_available(void);
+
+/**********************************************************
+ * in, out : nb_blocks * AES_BLOCK_SIZE bytes, out can be in
+ * Unmasked reference AES-128 in ECB mode, with the AES-NI
+ * instructions when aes_ni_available(), and with 
+ * aes_encrypt_128 (resp. aes_decrypt_128) otherwise
+**********************************************************/
+void aes_encrypt_128_blocks(const uint8_t * roundkeys, const uint8_t * in, uint8_t * out, size_t nb_blocks);
+
+void aes_decrypt_128_blocks(const uint8_t * roundkeys, const uint8_t * in, uint8_t * out, size_t nb_blocks);
+
+#endif
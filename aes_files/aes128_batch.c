@@ -0,0 +1,213 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "aes128_batch.h"
+
+#include "parallel.h"
+
+
+void block_sharing_pointers(uint8_t * block, uint8_t ** ptrs){
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		ptrs[i] = block + i * NB_SHARES;
+	}
+}
+
+
+uint8_t ** generate_roundkeys_sharing(const uint8_t * roundkeys){
+	uint8_t ** roundkeys_sharing = (uint8_t **)malloc(AES_ROUND_KEY_SIZE * sizeof(uint8_t *));
+	uint8_t * buf = (uint8_t *)malloc(AES_ROUND_KEY_SIZE * NB_SHARES);
+	for(int i = 0; i < AES_ROUND_KEY_SIZE; i++){
+		roundkeys_sharing[i] = buf + i * NB_SHARES;
+	}
+	generate_n_sharing_buffer(roundkeys, buf, AES_ROUND_KEY_SIZE);
+	return roundkeys_sharing;
+}
+
+
+void free_roundkeys_sharing(uint8_t ** roundkeys_sharing){
+	free(roundkeys_sharing[0]);
+	free(roundkeys_sharing);
+}
+
+
+void refresh_roundkeys_sharing(uint8_t ** roundkeys_sharing){
+	refresh_n_sharing_buffer(roundkeys_sharing[0], AES_ROUND_KEY_SIZE);
+}
+
+
+void add_block_sharing(uint8_t * a, uint8_t * b, uint8_t * c){
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		add_gadget_function(a + i * NB_SHARES, b + i * NB_SHARES, c + i * NB_SHARES);
+	}
+}
+
+
+typedef struct {
+	uint8_t ** roundkeys;
+	uint8_t * in;
+	uint8_t * out;
+	uint8_t ** in_list;
+	uint8_t ** out_list;
+	int decrypt;
+	size_t refresh_period;
+	const roundkeys_table * keys;
+	const uint32_t * key_index;
+} batch_job;
+
+
+static void batch_worker(void * arg, size_t begin, size_t end){
+	batch_job * job = (batch_job *)arg;
+	uint8_t * in_ptrs[AES_BLOCK_SIZE];
+	uint8_t * out_ptrs[AES_BLOCK_SIZE];
+	uint8_t ** roundkeys = job->roundkeys;
+	
+	if(job->refresh_period){
+		roundkeys = (uint8_t **)malloc(AES_ROUND_KEY_SIZE * sizeof(uint8_t *));
+		roundkeys[0] = (uint8_t *)malloc(AES_ROUND_KEY_SIZE * NB_SHARES);
+		// the caller's round keys need not be contiguous
+		for(int i = 0; i < AES_ROUND_KEY_SIZE; i++){
+			roundkeys[i] = roundkeys[0] + i * NB_SHARES;
+			memcpy(roundkeys[i], job->roundkeys[i], NB_SHARES);
+		}
+	}
+	
+	for(size_t b = begin; b < end; b++){
+		if(job->refresh_period && (b - begin) % job->refresh_period == 0)
+			refresh_roundkeys_sharing(roundkeys);
+		
+		if(job->in_list){
+			block_sharing_pointers(job->in_list[b], in_ptrs);
+			block_sharing_pointers(job->out_list[b], out_ptrs);
+		}
+		else{
+			block_sharing_pointers(job->in + b * AES_BLOCK_SHARING_SIZE, in_ptrs);
+			block_sharing_pointers(job->out + b * AES_BLOCK_SHARING_SIZE, out_ptrs);
+		}
+		
+		if(job->keys)
+			roundkeys = job->keys->roundkeys[job->key_index[b]];
+		
+		if(job->decrypt)
+			aes_decrypt_128_sharing(roundkeys, in_ptrs, out_ptrs);
+		else
+			aes_encrypt_128_sharing(roundkeys, in_ptrs, out_ptrs);
+	}
+	
+	if(job->refresh_period)
+		free_roundkeys_sharing(roundkeys);
+}
+
+
+void aes_encrypt_128_sharing_batch(uint8_t **roundkeys, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads){
+	batch_job job = { .roundkeys = roundkeys, .in = in, .out = out };
+	run_parallel(batch_worker, &job, nb_blocks, nb_threads);
+}
+
+
+void aes_decrypt_128_sharing_batch(uint8_t **roundkeys, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads){
+	batch_job job = { .roundkeys = roundkeys, .in = in, .out = out, .decrypt = 1 };
+	run_parallel(batch_worker, &job, nb_blocks, nb_threads);
+}
+
+
+void aes_encrypt_128_sharing_list(uint8_t **roundkeys, uint8_t ** in, uint8_t ** out, size_t nb_blocks, int nb_threads){
+	batch_job job = { .roundkeys = roundkeys, .in_list = in, .out_list = out };
+	run_parallel(batch_worker, &job, nb_blocks, nb_threads);
+}
+
+
+void aes_decrypt_128_sharing_list(uint8_t **roundkeys, uint8_t ** in, uint8_t ** out, size_t nb_blocks, int nb_threads){
+	batch_job job = { .roundkeys = roundkeys, .in_list = in, .out_list = out, .decrypt = 1 };
+	run_parallel(batch_worker, &job, nb_blocks, nb_threads);
+}
+
+
+void aes_encrypt_128_sharing_batch_refresh(uint8_t **roundkeys, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads, size_t refresh_period){
+	batch_job job = { .roundkeys = roundkeys, .in = in, .out = out, .refresh_period = refresh_period };
+	run_parallel(batch_worker, &job, nb_blocks, nb_threads);
+}
+
+
+void aes_decrypt_128_sharing_batch_refresh(uint8_t **roundkeys, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads, size_t refresh_period){
+	batch_job job = { .roundkeys = roundkeys, .in = in, .out = out, .decrypt = 1, .refresh_period = refresh_period };
+	run_parallel(batch_worker, &job, nb_blocks, nb_threads);
+}
+
+
+roundkeys_table * roundkeys_table_new(uint8_t *** roundkeys, size_t nb_keys){
+	roundkeys_table * table = (roundkeys_table *)malloc(sizeof(roundkeys_table));
+	if(table == NULL)
+		return NULL;
+	table->nb_keys = nb_keys;
+	table->buf = (uint8_t *)malloc(nb_keys * AES_ROUND_KEY_SIZE * NB_SHARES);
+	// the tables of pointers of the keys follow the array of tables
+	table->roundkeys = (uint8_t ***)malloc(nb_keys * (sizeof(uint8_t **) + AES_ROUND_KEY_SIZE * sizeof(uint8_t *)));
+	if(table->buf == NULL || table->roundkeys == NULL){
+		free(table->buf);
+		free(table->roundkeys);
+		free(table);
+		return NULL;
+	}
+	uint8_t ** ptrs = (uint8_t **)(table->roundkeys + nb_keys);
+	
+	for(size_t k = 0; k < nb_keys; k++){
+		uint8_t * key_buf = table->buf + k * AES_ROUND_KEY_SIZE * NB_SHARES;
+		table->roundkeys[k] = ptrs + k * AES_ROUND_KEY_SIZE;
+		for(int i = 0; i < AES_ROUND_KEY_SIZE; i++){
+			// the round keys are not necessarily contiguous
+			memcpy(key_buf + i * NB_SHARES, roundkeys[k][i], NB_SHARES);
+			table->roundkeys[k][i] = key_buf + i * NB_SHARES;
+		}
+	}
+	return table;
+}
+
+
+void roundkeys_table_free(roundkeys_table * table){
+	if(table == NULL)
+		return;
+	free(table->roundkeys);
+	free(table->buf);
+	free(table);
+}
+
+
+void aes_encrypt_128_sharing_batch_multikey(const roundkeys_table * keys, const uint32_t * key_index, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads){
+	batch_job job = { .in = in, .out = out, .keys = keys, .key_index = key_index };
+	run_parallel(batch_worker, &job, nb_blocks, nb_threads);
+}
+
+
+void aes_decrypt_128_sharing_batch_multikey(const roundkeys_table * keys, const uint32_t * key_index, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads){
+	batch_job job = { .in = in, .out = out, .decrypt = 1, .keys = keys, .key_index = key_index };
+	run_parallel(batch_worker, &job, nb_blocks, nb_threads);
+}
@@ -0,0 +1,177 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#ifndef AES128_BATCH_H
+#define AES128_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gadgets.h"
+#include "aes128_sharing.h"
+
+/**********************************************************
+ * n-share block buffers: a buffer of nb_blocks blocks
+ * stores, for each byte of each block, its NB_SHARES
+ * shares contiguously, i.e. share s of byte i of block b
+ * is at buf[(b * AES_BLOCK_SIZE + i) * NB_SHARES + s].
+ * This is the layout seen by aes_encrypt_128_sharing
+ * through its table of AES_BLOCK_SIZE pointers, so the
+ * blocks are given to the cipher without any copy.
+**********************************************************/
+#define AES_BLOCK_SHARING_SIZE (AES_BLOCK_SIZE * NB_SHARES)
+
+
+/**********************************************************
+ * block : one n-share block (AES_BLOCK_SHARING_SIZE bytes)
+ * ptrs : array of AES_BLOCK_SIZE pointers
+ * Fills ptrs so that ptrs[i] points to the NB_SHARES 
+ * shares of byte i of the block
+**********************************************************/
+void block_sharing_pointers(uint8_t * block, uint8_t ** ptrs);
+
+
+/**********************************************************
+ * roundkeys : AES_ROUND_KEY_SIZE byte round keys
+ * Returns the n-share round keys of roundkeys, as a table
+ * of AES_ROUND_KEY_SIZE pointers into one contiguous 
+ * buffer of AES_ROUND_KEY_SIZE * NB_SHARES bytes (the 
+ * buffer is roundkeys_sharing[0]). Both are released 
+ * with free_roundkeys_sharing
+**********************************************************/
+uint8_t ** generate_roundkeys_sharing(const uint8_t * roundkeys);
+
+void free_roundkeys_sharing(uint8_t ** roundkeys_sharing);
+
+
+/**********************************************************
+ * Re-randomizes the n-share round keys in place with 
+ * refresh_n_sharing_buffer. roundkeys_sharing must be 
+ * stored in one contiguous buffer starting at 
+ * roundkeys_sharing[0], as the round keys returned by 
+ * generate_roundkeys_sharing and key_cache_acquire.
+ * Must not be called while the round keys are in use by
+ * another thread.
+**********************************************************/
+void refresh_roundkeys_sharing(uint8_t ** roundkeys_sharing);
+
+
+/**********************************************************
+ * Adds two n-share blocks with add_gadget_function
+ * (c may alias a or b)
+**********************************************************/
+void add_block_sharing(uint8_t * a, uint8_t * b, uint8_t * c);
+
+
+/**********************************************************
+ * roundkeys : n-share round keys
+ * in : n-share block buffer of nb_blocks blocks
+ * out : n-share block buffer of nb_blocks blocks
+ * Encrypts (resp. decrypts) every block independently,
+ * spreading the blocks over nb_threads threads.
+ * in and out may be the same buffer.
+**********************************************************/
+void aes_encrypt_128_sharing_batch(uint8_t **roundkeys, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads);
+
+void aes_decrypt_128_sharing_batch(uint8_t **roundkeys, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads);
+
+
+/**********************************************************
+ * Same as above, but the blocks are given as two lists of
+ * nb_blocks pointers to n-share blocks that do not need to
+ * be contiguous (in[k] and out[k] may be the same block)
+**********************************************************/
+void aes_encrypt_128_sharing_list(uint8_t **roundkeys, uint8_t ** in, uint8_t ** out, size_t nb_blocks, int nb_threads);
+
+void aes_decrypt_128_sharing_list(uint8_t **roundkeys, uint8_t ** in, uint8_t ** out, size_t nb_blocks, int nb_threads);
+
+
+/**********************************************************
+ * n-share round keys of nb_keys keys, for the multi-key
+ * batches below. The sharings are gathered once into one
+ * contiguous buffer (key k at 
+ * buf + k * AES_ROUND_KEY_SIZE * NB_SHARES), and 
+ * roundkeys[k] is the table of AES_ROUND_KEY_SIZE 
+ * pointers of key k, so that the table can be kept and 
+ * reused by all the batches under these keys.
+**********************************************************/
+typedef struct {
+	size_t nb_keys;
+	uint8_t * buf;
+	uint8_t *** roundkeys;
+} roundkeys_table;
+
+
+/**********************************************************
+ * roundkeys : nb_keys n-share round keys (from 
+ * generate_roundkeys_sharing, key_cache_acquire, ...)
+ * Returns a table holding a copy of their sharings, NULL 
+ * if out of memory. The round keys can be released or 
+ * refreshed once the table is built.
+**********************************************************/
+roundkeys_table * roundkeys_table_new(uint8_t *** roundkeys, size_t nb_keys);
+
+void roundkeys_table_free(roundkeys_table * table);
+
+
+/**********************************************************
+ * keys : round keys of the blocks
+ * key_index : nb_blocks indexes in keys, block b being 
+ * encrypted (resp. decrypted) with the round keys
+ * keys->roundkeys[key_index[b]]
+ * Same as aes_encrypt_128_sharing_batch, with one key per
+ * block, so that many small messages under different keys
+ * are spread over the threads in a single batch.
+ * 
+ * The key of a block is only a lookup of its round key
+ * pointers before the block is processed: the blocks are
+ * not interleaved across keys nor grouped by key, so that
+ * this is the same as the _list batches with one round 
+ * key table per block. The blocks are split over the 
+ * threads in index order, so callers should sort them by
+ * key_index (all the blocks of a key next to each other)
+ * for each thread to work on few keys at a time.
+**********************************************************/
+void aes_encrypt_128_sharing_batch_multikey(const roundkeys_table * keys, const uint32_t * key_index, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads);
+
+void aes_decrypt_128_sharing_batch_multikey(const roundkeys_table * keys, const uint32_t * key_index, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads);
+
+
+/**********************************************************
+ * Same as aes_encrypt_128_sharing_batch, but each thread
+ * works on its own copy of the round keys, refreshed 
+ * before its first block and then every refresh_period
+ * blocks (1 for a refresh before every block). The round
+ * keys given by the caller are left unchanged.
+**********************************************************/
+void aes_encrypt_128_sharing_batch_refresh(uint8_t **roundkeys, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads, size_t refresh_period);
+
+void aes_decrypt_128_sharing_batch_refresh(uint8_t **roundkeys, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads, size_t refresh_period);
+
+#endif
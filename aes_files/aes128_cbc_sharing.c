@@ -0,0 +1,117 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#include <stdlib.h>
+
+#include "aes128_cbc_sharing.h"
+#include "gadgets.h"
+
+
+/**********************************************************
+ * c = a + iv, where iv is public
+**********************************************************/
+static void add_iv_sharing(uint8_t * a, const uint8_t * iv, uint8_t * c){
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		add_cons_gadget_function(iv[i], a + i * NB_SHARES, c + i * NB_SHARES);
+	}
+}
+
+
+void aes_cbc_encrypt_128_sharing(uint8_t **roundkeys, const uint8_t * iv, uint8_t * in, uint8_t * out, size_t nb_blocks){
+	uint8_t * ptrs[AES_BLOCK_SIZE];
+	
+	for(size_t b = 0; b < nb_blocks; b++){
+		uint8_t * x = out + b * AES_BLOCK_SHARING_SIZE;
+		if(b == 0)
+			add_iv_sharing(in, iv, x);
+		else
+			add_block_sharing(in + b * AES_BLOCK_SHARING_SIZE, x - AES_BLOCK_SHARING_SIZE, x);
+		
+		block_sharing_pointers(x, ptrs);
+		aes_encrypt_128_sharing(roundkeys, ptrs, ptrs);
+	}
+}
+
+
+void aes_cbc_decrypt_128_sharing(uint8_t **roundkeys, const uint8_t * iv, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads){
+	size_t chunk_blocks = CBC_DEC_CHUNK_BLOCKS * (nb_threads > 1 ? nb_threads : 1);
+	if(chunk_blocks > nb_blocks)
+		chunk_blocks = nb_blocks;
+	uint8_t * tmp = (uint8_t *)malloc(chunk_blocks * AES_BLOCK_SHARING_SIZE);
+	
+	/* 
+	 * The chunks (and the blocks inside a chunk) are processed
+	 * from the last one to the first one, so that the previous
+	 * ciphertext block is still available when out == in
+	 */
+	size_t end = nb_blocks;
+	while(end > 0){
+		size_t begin = end > chunk_blocks ? end - chunk_blocks : 0;
+		
+		aes_decrypt_128_sharing_batch(roundkeys, in + begin * AES_BLOCK_SHARING_SIZE, tmp, end - begin, nb_threads);
+		
+		for(size_t b = end; b-- > begin; ){
+			uint8_t * x = tmp + (b - begin) * AES_BLOCK_SHARING_SIZE;
+			if(b == 0)
+				add_iv_sharing(x, iv, out);
+			else
+				add_block_sharing(x, in + (b - 1) * AES_BLOCK_SHARING_SIZE, out + b * AES_BLOCK_SHARING_SIZE);
+		}
+		end = begin;
+	}
+	
+	free(tmp);
+}
+
+
+void aes_cbc_encrypt_128_sharing_multi(uint8_t **roundkeys, cbc_message_sharing * msgs, size_t nb_msgs, int nb_threads){
+	uint8_t ** list = (uint8_t **)malloc(nb_msgs * sizeof(uint8_t *));
+	size_t step, m, nb_active;
+	
+	for(step = 0; ; step++){
+		// chain the current block of every message that is not finished
+		nb_active = 0;
+		for(m = 0; m < nb_msgs; m++){
+			if(step >= msgs[m].nb_blocks)
+				continue;
+			uint8_t * x = msgs[m].out + step * AES_BLOCK_SHARING_SIZE;
+			if(step == 0)
+				add_iv_sharing(msgs[m].in, msgs[m].iv, x);
+			else
+				add_block_sharing(msgs[m].in + step * AES_BLOCK_SHARING_SIZE, x - AES_BLOCK_SHARING_SIZE, x);
+			list[nb_active++] = x;
+		}
+		if(nb_active == 0)
+			break;
+		
+		aes_encrypt_128_sharing_list(roundkeys, list, list, nb_active, nb_threads);
+	}
+	
+	free(list);
+}
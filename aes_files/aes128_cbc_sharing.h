@@ -0,0 +1,79 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#ifndef AES128_CBC_SHARING_H
+#define AES128_CBC_SHARING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes128_batch.h"
+
+/**********************************************************
+ * n-share AES-128 in CBC mode. Plaintexts and ciphertexts
+ * are n-share block buffers (see aes128_batch.h), the IV 
+ * is a public AES_BLOCK_SIZE byte array that is added to
+ * the first block with add_cons_gadget_function.
+ * 
+ * Encryption is serial inside a message, so the 
+ * throughput comes from aes_cbc_encrypt_128_sharing_multi
+ * that advances several independent messages in lockstep
+ * and encrypts their current blocks as one batch.
+ * Decryption only needs the previous ciphertext block, so
+ * all the blocks of a message are decrypted as a batch.
+**********************************************************/
+
+#define CBC_DEC_CHUNK_BLOCKS 64
+
+
+/**********************************************************
+ * roundkeys : n-share round keys
+ * iv : public initialization vector
+ * in : n-share block buffer of nb_blocks blocks
+ * out : n-share block buffer of nb_blocks blocks
+ * in and out may be the same buffer
+**********************************************************/
+void aes_cbc_encrypt_128_sharing(uint8_t **roundkeys, const uint8_t * iv, uint8_t * in, uint8_t * out, size_t nb_blocks);
+
+void aes_cbc_decrypt_128_sharing(uint8_t **roundkeys, const uint8_t * iv, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_threads);
+
+
+/**********************************************************
+ * One message of a multi-message CBC encryption
+**********************************************************/
+typedef struct {
+	const uint8_t * iv;
+	uint8_t * in;
+	uint8_t * out;
+	size_t nb_blocks;
+} cbc_message_sharing;
+
+void aes_cbc_encrypt_128_sharing_multi(uint8_t **roundkeys, cbc_message_sharing * msgs, size_t nb_msgs, int nb_threads);
+
+#endif
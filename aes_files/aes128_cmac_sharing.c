@@ -0,0 +1,148 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "aes128_cmac_sharing.h"
+#include "gadgets.h"
+
+
+/**********************************************************
+ * out = in.x in GF(2^128), share by share: every share is
+ * shifted left by one bit and reduced by 0x87 if its own 
+ * most significant bit is set. The sum of the shares is 
+ * the doubling of the shared value since the map is linear
+ * in the bits of its input.
+**********************************************************/
+static void cmac_double_sharing(uint8_t * in, uint8_t * out){
+	for(int s = 0; s < NB_SHARES; s++){
+		uint8_t msb = in[s] >> 7;
+		for(int i = 0; i < AES_BLOCK_SIZE - 1; i++){
+			out[i * NB_SHARES + s] = (uint8_t)(in[i * NB_SHARES + s] << 1) | (in[(i + 1) * NB_SHARES + s] >> 7);
+		}
+		out[(AES_BLOCK_SIZE - 1) * NB_SHARES + s] = (uint8_t)(in[(AES_BLOCK_SIZE - 1) * NB_SHARES + s] << 1) ^ (0x87 & -msb);
+	}
+}
+
+
+static size_t cmac_nb_blocks(size_t len){
+	return len == 0 ? 1 : (len + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+}
+
+
+/**********************************************************
+ * x = x + M_b, or x = M_b for the first block, where the 
+ * last block is padded and masked with the subkey
+**********************************************************/
+static void cmac_chain_block(uint8_t * k1, uint8_t * k2, uint8_t * msg, size_t len, size_t b, uint8_t * x){
+	uint8_t * m = msg + b * AES_BLOCK_SHARING_SIZE;
+	
+	if(b + 1 < cmac_nb_blocks(len)){
+		if(b == 0)
+			memcpy(x, m, AES_BLOCK_SHARING_SIZE);
+		else
+			add_block_sharing(m, x, x);
+		return;
+	}
+	
+	uint8_t * last = scratch_push(AES_BLOCK_SIZE);
+	size_t rem = len - b * AES_BLOCK_SIZE;
+	if(rem == AES_BLOCK_SIZE){
+		add_block_sharing(m, k1, last);
+	}
+	else{
+		// 10* padding, the padding bytes are public
+		for(size_t i = 0; i < AES_BLOCK_SIZE; i++){
+			if(i < rem)
+				add_gadget_function(m + i * NB_SHARES, k2 + i * NB_SHARES, last + i * NB_SHARES);
+			else if(i == rem)
+				add_cons_gadget_function(0x80, k2 + i * NB_SHARES, last + i * NB_SHARES);
+			else
+				memcpy(last + i * NB_SHARES, k2 + i * NB_SHARES, NB_SHARES);
+		}
+	}
+	
+	if(b == 0)
+		memcpy(x, last, AES_BLOCK_SHARING_SIZE);
+	else
+		add_block_sharing(last, x, x);
+	scratch_pop(AES_BLOCK_SIZE);
+}
+
+
+void aes_cmac_subkeys_128_sharing(uint8_t **roundkeys, uint8_t * k1, uint8_t * k2){
+	uint8_t zero[AES_BLOCK_SIZE] = {0};
+	uint8_t * ptrs[AES_BLOCK_SIZE];
+	uint8_t * l = scratch_push(AES_BLOCK_SIZE);
+	
+	generate_n_sharing_buffer(zero, l, AES_BLOCK_SIZE);
+	block_sharing_pointers(l, ptrs);
+	aes_encrypt_128_sharing(roundkeys, ptrs, ptrs);
+	
+	cmac_double_sharing(l, k1);
+	cmac_double_sharing(k1, k2);
+	scratch_pop(AES_BLOCK_SIZE);
+}
+
+
+void aes_cmac_128_sharing(uint8_t **roundkeys, uint8_t * k1, uint8_t * k2, uint8_t * msg, size_t len, uint8_t * tag){
+	uint8_t * ptrs[AES_BLOCK_SIZE];
+	size_t nb_blocks = cmac_nb_blocks(len);
+	
+	block_sharing_pointers(tag, ptrs);
+	for(size_t b = 0; b < nb_blocks; b++){
+		cmac_chain_block(k1, k2, msg, len, b, tag);
+		aes_encrypt_128_sharing(roundkeys, ptrs, ptrs);
+	}
+}
+
+
+void aes_cmac_128_sharing_multi(uint8_t **roundkeys, uint8_t * k1, uint8_t * k2, cmac_message_sharing * msgs, size_t nb_msgs, int nb_threads){
+	uint8_t ** list = (uint8_t **)malloc(nb_msgs * sizeof(uint8_t *));
+	size_t step, m, nb_active;
+	
+	for(step = 0; ; step++){
+		// chain the current block of every message that is not finished
+		nb_active = 0;
+		for(m = 0; m < nb_msgs; m++){
+			if(step >= cmac_nb_blocks(msgs[m].len))
+				continue;
+			cmac_chain_block(k1, k2, msgs[m].msg, msgs[m].len, step, msgs[m].tag);
+			list[nb_active++] = msgs[m].tag;
+		}
+		if(nb_active == 0)
+			break;
+		
+		aes_encrypt_128_sharing_list(roundkeys, list, list, nb_active, nb_threads);
+	}
+	
+	free(list);
+}
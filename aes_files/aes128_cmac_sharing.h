@@ -0,0 +1,84 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+
+#ifndef AES128_CMAC_SHARING_H
+#define AES128_CMAC_SHARING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes128_batch.h"
+
+/**********************************************************
+ * n-share AES-CMAC (RFC 4493). Messages, subkeys and tags
+ * are n-share buffers in the block layout of aes128_batch.h
+ * (the shares of byte i at i * NB_SHARES), the message 
+ * length in bytes is public.
+ * 
+ * The subkeys K1 = L.x and K2 = L.x^2 with L = E_K(0) are
+ * derived without ever compressing L: the doubling in 
+ * GF(2^128), including the conditional reduction by 0x87,
+ * is linear over GF(2) and is applied share by share.
+ * 
+ * Like CBC encryption, a CMAC chain is serial, so the 
+ * throughput comes from aes_cmac_128_sharing_multi that
+ * advances several independent messages in lockstep and
+ * encrypts their current blocks as one batch.
+**********************************************************/
+
+
+/**********************************************************
+ * roundkeys : n-share round keys
+ * k1, k2 : n-share blocks, outputs
+**********************************************************/
+void aes_cmac_subkeys_128_sharing(uint8_t **roundkeys, uint8_t * k1, uint8_t * k2);
+
+
+/**********************************************************
+ * roundkeys : n-share round keys
+ * k1, k2 : n-share subkeys from aes_cmac_subkeys_128_sharing
+ * msg : n-share buffer of len bytes (len may be 0)
+ * tag : n-share block, output
+**********************************************************/
+void aes_cmac_128_sharing(uint8_t **roundkeys, uint8_t * k1, uint8_t * k2, uint8_t * msg, size_t len, uint8_t * tag);
+
+
+/**********************************************************
+ * One message of a multi-message CMAC
+**********************************************************/
+typedef struct {
+	uint8_t * msg;
+	size_t len;
+	uint8_t * tag;
+} cmac_message_sharing;
+
+void aes_cmac_128_sharing_multi(uint8_t **roundkeys, uint8_t * k1, uint8_t * k2, cmac_message_sharing * msgs, size_t nb_msgs, int nb_threads);
+
+#endif
@@ -0,0 +1,162 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aes128_pipeline.h"
+#include "parallel.h"
+
+
+typedef struct {
+	uint8_t * block;
+	uint8_t ind_state[AES_BLOCK_SIZE];
+} pipeline_item;
+
+
+typedef struct {
+	uint8_t ** roundkeys;
+	int first_round;
+	int last_round;
+	spsc_queue * in;            // NULL for the first stage
+	spsc_queue * out;           // NULL for the last stage
+	pipeline_item * items;      // input of the first stage
+	size_t nb_items;
+} pipeline_stage;
+
+
+/**********************************************************
+ * Runs the rounds of the stage on every item, until the
+ * end marker (NULL), which is passed to the next stage
+**********************************************************/
+static void * run_stage(void * arg){
+	pipeline_stage * stage = (pipeline_stage *)arg;
+	uint8_t * ptrs[AES_BLOCK_SIZE];
+	pipeline_item * item;
+	size_t k = 0;
+	
+	for(;;){
+		if(stage->in)
+			item = (pipeline_item *)spsc_queue_pop(stage->in);
+		else
+			item = k < stage->nb_items ? &stage->items[k++] : NULL;
+		if(!item)
+			break;
+		
+		block_sharing_pointers(item->block, ptrs);
+		for(int r = stage->first_round; r <= stage->last_round; r++){
+			aes_encrypt_round_sharing(stage->roundkeys, r, ptrs, item->ind_state);
+		}
+		
+		if(stage->out)
+			spsc_queue_push(stage->out, item);
+	}
+	if(stage->out)
+		spsc_queue_push(stage->out, NULL);
+	return NULL;
+}
+
+
+void aes_encrypt_128_sharing_pipeline(uint8_t **roundkeys, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_stages){
+	pipeline_stage stages[AES_ROUNDS];
+	spsc_queue queues[AES_ROUNDS - 1];
+	pthread_t threads[AES_ROUNDS];
+	int s, started = 1;
+	
+	if(nb_stages < 1)
+		nb_stages = 1;
+	if(nb_stages > AES_ROUNDS)
+		nb_stages = AES_ROUNDS;
+	if(nb_blocks == 0)
+		return;
+	
+	pipeline_item * items = (pipeline_item *)malloc(nb_blocks * sizeof(pipeline_item));
+	if(!items){
+		// no work list: encrypt the blocks one after the other here
+		aes_encrypt_128_sharing_batch(roundkeys, in, out, nb_blocks, 1);
+		return;
+	}
+	if(in != out)
+		memcpy(out, in, nb_blocks * AES_BLOCK_SHARING_SIZE);
+	for(size_t k = 0; k < nb_blocks; k++){
+		items[k].block = out + k * AES_BLOCK_SHARING_SIZE;
+		for(int i = 0; i < AES_BLOCK_SIZE; i++){
+			items[k].ind_state[i] = i;
+		}
+	}
+	
+	for(s = 0; s < nb_stages - 1; s++){
+		if(spsc_queue_init(&queues[s], PIPELINE_QUEUE_DEPTH) != 0){
+			// could not allocate every queue: run a single stage
+			while(s-- > 0){
+				spsc_queue_destroy(&queues[s]);
+			}
+			nb_stages = 1;
+			break;
+		}
+	}
+	
+	// stage s runs the rounds (s * AES_ROUNDS / nb_stages, (s + 1) * AES_ROUNDS / nb_stages]
+	for(s = 0; s < nb_stages; s++){
+		stages[s].roundkeys = roundkeys;
+		stages[s].first_round = s == 0 ? 0 : 1 + s * AES_ROUNDS / nb_stages;
+		stages[s].last_round = (s + 1) * AES_ROUNDS / nb_stages;
+		stages[s].in = s == 0 ? NULL : &queues[s - 1];
+		stages[s].out = s == nb_stages - 1 ? NULL : &queues[s];
+		stages[s].items = items;
+		stages[s].nb_items = nb_blocks;
+	}
+	for(s = 1; s < nb_stages; s++){
+		if(pthread_create(&threads[s], NULL, run_stage, &stages[s]) != 0)
+			break;
+		started++;
+	}
+	
+	if(started == nb_stages){
+		run_stage(&stages[0]);
+	}
+	else{
+		// could not start every stage: stop the ones that run, and encrypt here
+		spsc_queue_push(&queues[0], NULL);
+		stages[0].first_round = 0;
+		stages[0].last_round = AES_ROUNDS;
+		stages[0].out = NULL;
+	}
+	for(s = 1; s < started; s++){
+		pthread_join(threads[s], NULL);
+	}
+	if(started != nb_stages)
+		run_stage(&stages[0]);
+	
+	for(s = 0; s < nb_stages - 1; s++){
+		spsc_queue_destroy(&queues[s]);
+	}
+	free(items);
+}
@@ -0,0 +1,70 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#ifndef AES128_PIPELINE_H
+#define AES128_PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes128_batch.h"
+
+/**********************************************************
+ * Round level pipeline for streams of blocks.
+ * 
+ * The rounds of aes_encrypt_128_sharing (see 
+ * aes_encrypt_round_sharing) are split into nb_stages 
+ * stages of consecutive rounds, each stage runs in its 
+ * own thread, and the stages hand the blocks (with their
+ * ShiftRows indirection) to the next one through 
+ * lock-free single-producer / single-consumer queues. Up
+ * to nb_stages blocks are thus in different rounds at
+ * the same time.
+ * 
+ * Unlike aes_encrypt_128_sharing_batch, the throughput 
+ * is limited by the slowest stage, and each block goes 
+ * through every core, so this is meant for comparison 
+ * (./bench pipeline) and for streams where the blocks
+ * arrive one by one.
+**********************************************************/
+
+#define PIPELINE_QUEUE_DEPTH 64
+
+
+/**********************************************************
+ * roundkeys : n-share round keys
+ * in : n-share block buffer of nb_blocks blocks
+ * out : n-share block buffer of nb_blocks blocks
+ * nb_stages : number of stages/threads (1 to AES_ROUNDS)
+ * Encrypts every block independently through the 
+ * pipeline. in and out may be the same buffer.
+**********************************************************/
+void aes_encrypt_128_sharing_pipeline(uint8_t **roundkeys, uint8_t * in, uint8_t * out, size_t nb_blocks, int nb_stages);
+
+#endif
@@ -33,10 +33,14 @@
 
 ***************************************************************************/
 
+#include <string.h>
+
 #include "aes128_sharing.h"
 
 #include "gf256.h"
 #include "gadgets.h"
+#include "perf_trace.h"
+#include "sbox_table_sharing.h"
 
 
 /**********************************************************
@@ -51,16 +55,26 @@
  * variables of the same type (uint8_t)
 **********************************************************/
 
+/**********************************************************
+ * The state and the temporaries of the S-boxes and of 
+ * MixColumns are taken from the scratch arena of 
+ * gadgets.h rather than the stack, so that very high 
+ * orders do not depend on the stack size: SCRATCH(k) is
+ * the k-th variable of the block returned by scratch_push
+**********************************************************/
+#define SCRATCH(k) (scratch + (k) * NB_SHARES)
+
 void exp254_sharing(uint8_t *x, uint8_t * out){
+	uint8_t * scratch = scratch_push(17);
 	
-	uint8_t x_copy0[NB_SHARES], x_tmp0[NB_SHARES], x_copy1[NB_SHARES], x_tmp1[NB_SHARES], x_copy2[NB_SHARES], x_copy3[NB_SHARES];
-	uint8_t tmp[NB_SHARES];
-	uint8_t tmp_copy0[NB_SHARES], tmp_copy1[NB_SHARES];
-	uint8_t res[NB_SHARES];
-	uint8_t res_copy0[NB_SHARES], res_copy1[NB_SHARES];
-	uint8_t tmp2[NB_SHARES];
-	uint8_t tmp_tmp0[NB_SHARES], tmp_copy2[NB_SHARES];
-	uint8_t tmp2_copy0[NB_SHARES], tmp2_copy1[NB_SHARES];
+	uint8_t * x_copy0 = SCRATCH(0), * x_tmp0 = SCRATCH(1), * x_copy1 = SCRATCH(2), * x_tmp1 = SCRATCH(3), * x_copy2 = SCRATCH(4), * x_copy3 = SCRATCH(5);
+	uint8_t * tmp = SCRATCH(6);
+	uint8_t * tmp_copy0 = SCRATCH(7), * tmp_copy1 = SCRATCH(8);
+	uint8_t * res = SCRATCH(9);
+	uint8_t * res_copy0 = SCRATCH(10), * res_copy1 = SCRATCH(11);
+	uint8_t * tmp2 = SCRATCH(12);
+	uint8_t * tmp_tmp0 = SCRATCH(13), * tmp_copy2 = SCRATCH(14);
+	uint8_t * tmp2_copy0 = SCRATCH(15), * tmp2_copy1 = SCRATCH(16);
 	
 	copy_gadget_function(x, x_copy0, x_tmp0);
 	copy_gadget_function(x_tmp0, x_copy1, x_tmp1);
@@ -95,26 +109,29 @@ void exp254_sharing(uint8_t *x, uint8_t * out){
 	
 	copy_gadget_function(res, res_copy0, res_copy1);
 	mult_gadget_function(res_copy0, res_copy1, out);    //254
+	
+	scratch_pop(17);
 }	
 	
 
-void get_sbox_value_sharing(uint8_t * x, uint8_t * out){
+void get_sbox_value_sharing_poly(uint8_t * x, uint8_t * out){
+	uint8_t * scratch = scratch_push(24);
 	
 	//Exponentiation
-	uint8_t new_x[NB_SHARES];
+	uint8_t * new_x = SCRATCH(0);
 	exp254_sharing(x, new_x);	
 	
 	
 	//Affine function
-	uint8_t tmp[NB_SHARES];
-	uint8_t tmp_copy0[NB_SHARES], tmp_copy1[NB_SHARES];
-	uint8_t res[NB_SHARES];
-	uint8_t res_copy0[NB_SHARES], res_copy1[NB_SHARES];
-	uint8_t tmp2[NB_SHARES];
-	uint8_t tmp2_copy0[NB_SHARES], tmp2_copy1[NB_SHARES];
-	uint8_t new_x_copy0[NB_SHARES], new_x_tmp0[NB_SHARES], new_x_copy1[NB_SHARES], new_x_tmp1[NB_SHARES], new_x_copy2[NB_SHARES], new_x_tmp2[NB_SHARES], 
-			new_x_copy3[NB_SHARES], new_x_tmp3[NB_SHARES], new_x_copy4[NB_SHARES], new_x_tmp4[NB_SHARES], new_x_copy5[NB_SHARES], new_x_tmp5[NB_SHARES],
-			new_x_copy6[NB_SHARES], new_x_copy7[NB_SHARES];
+	uint8_t * tmp = SCRATCH(1);
+	uint8_t * tmp_copy0 = SCRATCH(2), * tmp_copy1 = SCRATCH(3);
+	uint8_t * res = SCRATCH(4);
+	uint8_t * res_copy0 = SCRATCH(5), * res_copy1 = SCRATCH(6);
+	uint8_t * tmp2 = SCRATCH(7);
+	uint8_t * tmp2_copy0 = SCRATCH(8), * tmp2_copy1 = SCRATCH(9);
+	uint8_t * new_x_copy0 = SCRATCH(10), * new_x_tmp0 = SCRATCH(11), * new_x_copy1 = SCRATCH(12), * new_x_tmp1 = SCRATCH(13), * new_x_copy2 = SCRATCH(14), * new_x_tmp2 = SCRATCH(15), 
+			* new_x_copy3 = SCRATCH(16), * new_x_tmp3 = SCRATCH(17), * new_x_copy4 = SCRATCH(18), * new_x_tmp4 = SCRATCH(19), * new_x_copy5 = SCRATCH(20), * new_x_tmp5 = SCRATCH(21),
+			* new_x_copy6 = SCRATCH(22), * new_x_copy7 = SCRATCH(23);
 	copy_gadget_function(new_x, new_x_copy0, new_x_tmp0); copy_gadget_function(new_x_tmp0, new_x_copy1, new_x_tmp1); copy_gadget_function(new_x_tmp1, new_x_copy2, new_x_tmp2);
 	copy_gadget_function(new_x_tmp2, new_x_copy3, new_x_tmp3); copy_gadget_function(new_x_tmp3, new_x_copy4, new_x_tmp4); copy_gadget_function(new_x_tmp4, new_x_copy5, new_x_tmp5);
 	copy_gadget_function(new_x_tmp5, new_x_copy6, new_x_copy7); 
@@ -158,18 +175,21 @@ void get_sbox_value_sharing(uint8_t * x, uint8_t * out){
 	add_gadget_function(res, tmp, tmp2);
 	
 	add_cons_gadget_function(99, tmp2, out);
-
+	
+	scratch_pop(24);
 }
 
 
-void get_inv_sbox_value_sharing(uint8_t * x, uint8_t * out){
+void get_inv_sbox_value_sharing_poly(uint8_t * x, uint8_t * out){
+	uint8_t * scratch = scratch_push(22);
+	
 	//Inverse of Affine function
-	uint8_t tmp[NB_SHARES], tmp2[NB_SHARES], res[NB_SHARES];
-	uint8_t tmp2_copy0[NB_SHARES], tmp2_copy1[NB_SHARES];
-	uint8_t res_copy0[NB_SHARES], res_copy1[NB_SHARES];
-	uint8_t x_copy0[NB_SHARES], x_tmp0[NB_SHARES], x_copy1[NB_SHARES], x_tmp1[NB_SHARES], x_copy2[NB_SHARES], x_tmp2[NB_SHARES], 
-			x_copy3[NB_SHARES], x_tmp3[NB_SHARES], x_copy4[NB_SHARES], x_tmp4[NB_SHARES], x_copy5[NB_SHARES], x_tmp5[NB_SHARES],
-			x_copy6[NB_SHARES], x_copy7[NB_SHARES];
+	uint8_t * tmp = SCRATCH(0), * tmp2 = SCRATCH(1), * res = SCRATCH(2);
+	uint8_t * tmp2_copy0 = SCRATCH(3), * tmp2_copy1 = SCRATCH(4);
+	uint8_t * res_copy0 = SCRATCH(5), * res_copy1 = SCRATCH(6);
+	uint8_t * x_copy0 = SCRATCH(7), * x_tmp0 = SCRATCH(8), * x_copy1 = SCRATCH(9), * x_tmp1 = SCRATCH(10), * x_copy2 = SCRATCH(11), * x_tmp2 = SCRATCH(12), 
+			* x_copy3 = SCRATCH(13), * x_tmp3 = SCRATCH(14), * x_copy4 = SCRATCH(15), * x_tmp4 = SCRATCH(16), * x_copy5 = SCRATCH(17), * x_tmp5 = SCRATCH(18),
+			* x_copy6 = SCRATCH(19), * x_copy7 = SCRATCH(20);
 	copy_gadget_function(x, x_copy0, x_tmp0); copy_gadget_function(x_tmp0, x_copy1, x_tmp1); copy_gadget_function(x_tmp1, x_copy2, x_tmp2);
 	copy_gadget_function(x_tmp2, x_copy3, x_tmp3); copy_gadget_function(x_tmp3, x_copy4, x_tmp4); copy_gadget_function(x_tmp4, x_copy5, x_tmp5);
 	copy_gadget_function(x_tmp5, x_copy6, x_copy7); 
@@ -212,11 +232,31 @@ void get_inv_sbox_value_sharing(uint8_t * x, uint8_t * out){
 	mult_cons_gadget_function(5, x_copy7, tmp);
 	add_gadget_function(res, tmp, tmp2);
 	
-	uint8_t new_x[NB_SHARES];
+	uint8_t * new_x = SCRATCH(21);
 	add_cons_gadget_function(5, tmp2, new_x);
 	
 	//Exponentiation
 	exp254_sharing(new_x, out);
+	
+	scratch_pop(22);
+}
+
+
+void get_sbox_value_sharing(uint8_t * x, uint8_t * out){
+#if NB_SHARES <= SBOX_TABLE_MAX_SHARES
+	get_sbox_value_sharing_table(x, out);
+#else
+	get_sbox_value_sharing_poly(x, out);
+#endif
+}
+
+
+void get_inv_sbox_value_sharing(uint8_t * x, uint8_t * out){
+#if NB_SHARES <= SBOX_TABLE_MAX_SHARES
+	get_inv_sbox_value_sharing_table(x, out);
+#else
+	get_inv_sbox_value_sharing_poly(x, out);
+#endif
 }
 
 
@@ -227,7 +267,10 @@ void get_inv_sbox_value_sharing(uint8_t * x, uint8_t * out){
  * and copying whole arrays, we use dynamic indexing with
  * the variable ind_state and lightly tweak the code of
  * the AES encryption and decryption functions to use
- * ind_state.
+ * ind_state. aes_encrypt_128_sharing and 
+ * aes_decrypt_128_sharing fold ShiftRows into MixColumns
+ * instead (see aes128_sharing.c); ind_state is kept for
+ * the round by round and column by column interfaces.
 **********************************************************/
 
 void shift_rows_sharing(uint8_t ** state, uint8_t * ind_state){
@@ -313,9 +356,100 @@ void inv_shift_rows_sharing(uint8_t ** state, uint8_t * ind_state){
 }
 
 
+/**********************************************************
+ * out = a + b (+ rk when rk is not NULL)
+**********************************************************/
+static void mix_column_output(uint8_t * a, uint8_t * b, uint8_t * rk, uint8_t * out){
+	if(rk){
+		add_gadget_function(a, b, a);
+		add_gadget_function(a, rk, out);
+	}
+	else
+		add_gadget_function(a, b, out);
+}
+
+
+/**********************************************************
+ * in : the 4 n-share bytes of a column
+ * out : the 4 n-share outputs (can be in)
+ * rk : the 4 round key bytes added to the outputs, or NULL
+ * MixColumns on one column, with AddRoundKey fused into
+ * the last addition of each output. The inputs are copied
+ * before any output is written.
+**********************************************************/
+static void mix_column_kernel(uint8_t ** in, uint8_t ** out, uint8_t ** rk){
+	uint8_t * scratch = scratch_push(32);
+	
+	uint8_t * t = SCRATCH(0);
+	uint8_t * tmp = SCRATCH(1);
+	uint8_t * statei_copy0 = SCRATCH(2), * statei_tmp0 = SCRATCH(3), * statei_copy1 = SCRATCH(4), * statei_tmp1 = SCRATCH(5),
+			* statei_copy2 = SCRATCH(6), * statei_copy3 = SCRATCH(7);
+	copy_gadget_function(in[0], statei_copy0, statei_tmp0); copy_gadget_function(statei_tmp0, statei_copy1, statei_tmp1);
+	copy_gadget_function(statei_tmp1, statei_copy2, statei_copy3);
+	
+	uint8_t * statei1_copy0 = SCRATCH(8), * statei1_tmp0 = SCRATCH(9), * statei1_copy1 = SCRATCH(10), * statei1_tmp1 = SCRATCH(11),
+			* statei1_copy2 = SCRATCH(12), * statei1_copy3 = SCRATCH(13);
+	copy_gadget_function(in[1], statei1_copy0, statei1_tmp0); copy_gadget_function(statei1_tmp0, statei1_copy1, statei1_tmp1);
+	copy_gadget_function(statei1_tmp1, statei1_copy2, statei1_copy3);
+	
+	uint8_t * statei2_copy0 = SCRATCH(14), * statei2_tmp0 = SCRATCH(15), * statei2_copy1 = SCRATCH(16), * statei2_tmp1 = SCRATCH(17),
+			* statei2_copy2 = SCRATCH(18), * statei2_copy3 = SCRATCH(19);
+	copy_gadget_function(in[2], statei2_copy0, statei2_tmp0); copy_gadget_function(statei2_tmp0, statei2_copy1, statei2_tmp1);
+	copy_gadget_function(statei2_tmp1, statei2_copy2, statei2_copy3);
+	
+	uint8_t * statei3_copy0 = SCRATCH(20), * statei3_tmp0 = SCRATCH(21), * statei3_copy1 = SCRATCH(22), * statei3_tmp1 = SCRATCH(23),
+			* statei3_copy2 = SCRATCH(24), * statei3_copy3 = SCRATCH(25);
+	copy_gadget_function(in[3], statei3_copy0, statei3_tmp0); copy_gadget_function(statei3_tmp0, statei3_copy1, statei3_tmp1);
+	copy_gadget_function(statei3_tmp1, statei3_copy2, statei3_copy3);
+
+
+	//t = state[i] ^ state[i+1] ^ state[i+2] ^ state[i+3];
+	add_gadget_function(statei_copy0, statei1_copy0, t);
+	add_gadget_function(statei2_copy0, t, tmp);
+	add_gadget_function(statei3_copy0, tmp, t);
+	
+	uint8_t * t_copy0 = SCRATCH(26), * t_tmp0 = SCRATCH(27), * t_copy1 = SCRATCH(28), * t_tmp1 = SCRATCH(29), * t_copy2 = SCRATCH(30), * t_copy3 = SCRATCH(31);
+	copy_gadget_function(t, t_copy0, t_tmp0); copy_gadget_function(t_tmp0, t_copy1, t_tmp1); copy_gadget_function(t_tmp1, t_copy2, t_copy3);
+	
+	
+	//ciphertext[i]   = Multiply(2, state[i]   ^ state[i+1]) ^ state[i]   ^ t;
+	add_gadget_function(statei_copy1, statei1_copy1, tmp);
+	mult_cons_gadget_function(2, tmp, t);
+	add_gadget_function(statei_copy2, t, tmp);
+	mix_column_output(tmp, t_copy0, rk ? rk[0] : NULL, out[0]);
+	
+	//ciphertext[i+1] = Multiply(2, state[i+1] ^ state[i+2]) ^ state[i+1] ^ t;
+	add_gadget_function(statei1_copy2, statei2_copy1, tmp);
+	mult_cons_gadget_function(2, tmp, t);
+	add_gadget_function(statei1_copy3, t, tmp);
+	mix_column_output(tmp, t_copy1, rk ? rk[1] : NULL, out[1]);
+	
+	
+	//ciphertext[i+2] = Multiply(2, state[i+2] ^ state[i+3]) ^ state[i+2] ^ t;
+	add_gadget_function(statei2_copy2, statei3_copy1, tmp);
+	mult_cons_gadget_function(2, tmp, t);
+	add_gadget_function(statei2_copy3, t, tmp);
+	mix_column_output(tmp, t_copy2, rk ? rk[2] : NULL, out[2]);
+	
+	
+	//ciphertext[i+3] = Multiply(2, state[i+3] ^ state[i]  ) ^ state[i+3] ^ t;
+	add_gadget_function(statei3_copy2, statei_copy3, tmp);
+	mult_cons_gadget_function(2, tmp, t);
+	add_gadget_function(statei3_copy3, t, tmp);
+	mix_column_output(tmp, t_copy3, rk ? rk[3] : NULL, out[3]);
+	
+	scratch_pop(32);
+}
+
+
+void mix_column_sharing(uint8_t ** state, uint8_t ** ciphertext, uint8_t * ind_state, int i){
+	uint8_t * in[4] = { state[ind_state[i]], state[ind_state[i+1]], state[ind_state[i+2]], state[ind_state[i+3]] };
+	uint8_t * out[4] = { ciphertext[ind_state[i]], ciphertext[ind_state[i+1]], ciphertext[ind_state[i+2]], ciphertext[ind_state[i+3]] };
+	mix_column_kernel(in, out, NULL);
+}
+
+
 void mix_columns_sharing(uint8_t ** state, uint8_t ** ciphertext, uint8_t * ind_state){
-	uint8_t t[NB_SHARES];
-	uint8_t tmp[NB_SHARES];
 	/*
 	 * MixColumns 
 	 * [02 03 01 01]   [s0  s4  s8  s12]
@@ -324,68 +458,77 @@ void mix_columns_sharing(uint8_t ** state, uint8_t ** ciphertext, uint8_t * ind_
 	 * [03 01 01 02]   [s3  s7  s11 s15]
 	 */
 	for (int i = 0; i < AES_BLOCK_SIZE; i+=4)  {
-		uint8_t statei_copy0[NB_SHARES], statei_tmp0[NB_SHARES], statei_copy1[NB_SHARES], statei_tmp1[NB_SHARES],
-				statei_copy2[NB_SHARES], statei_copy3[NB_SHARES];
-		copy_gadget_function(state[ind_state[i]], statei_copy0, statei_tmp0); copy_gadget_function(statei_tmp0, statei_copy1, statei_tmp1);
-		copy_gadget_function(statei_tmp1, statei_copy2, statei_copy3);
-		
-		uint8_t statei1_copy0[NB_SHARES], statei1_tmp0[NB_SHARES], statei1_copy1[NB_SHARES], statei1_tmp1[NB_SHARES],
-				statei1_copy2[NB_SHARES], statei1_copy3[NB_SHARES];
-		copy_gadget_function(state[ind_state[i+1]], statei1_copy0, statei1_tmp0); copy_gadget_function(statei1_tmp0, statei1_copy1, statei1_tmp1);
-		copy_gadget_function(statei1_tmp1, statei1_copy2, statei1_copy3);
-		
-		uint8_t statei2_copy0[NB_SHARES], statei2_tmp0[NB_SHARES], statei2_copy1[NB_SHARES], statei2_tmp1[NB_SHARES],
-				statei2_copy2[NB_SHARES], statei2_copy3[NB_SHARES];
-		copy_gadget_function(state[ind_state[i+2]], statei2_copy0, statei2_tmp0); copy_gadget_function(statei2_tmp0, statei2_copy1, statei2_tmp1);
-		copy_gadget_function(statei2_tmp1, statei2_copy2, statei2_copy3);
-		
-		uint8_t statei3_copy0[NB_SHARES], statei3_tmp0[NB_SHARES], statei3_copy1[NB_SHARES], statei3_tmp1[NB_SHARES],
-				statei3_copy2[NB_SHARES], statei3_copy3[NB_SHARES];
-		copy_gadget_function(state[ind_state[i+3]], statei3_copy0, statei3_tmp0); copy_gadget_function(statei3_tmp0, statei3_copy1, statei3_tmp1);
-		copy_gadget_function(statei3_tmp1, statei3_copy2, statei3_copy3);
+		mix_column_sharing(state, ciphertext, ind_state, i);
+	}
+}
 
 
-		//t = state[i] ^ state[i+1] ^ state[i+2] ^ state[i+3];
-		add_gadget_function(statei_copy0, statei1_copy0, t);
-		add_gadget_function(statei2_copy0, t, tmp);
-		add_gadget_function(statei3_copy0, tmp, t);
-		
-		uint8_t t_copy0[NB_SHARES], t_tmp0[NB_SHARES], t_copy1[NB_SHARES], t_tmp1[NB_SHARES], t_copy2[NB_SHARES], t_copy3[NB_SHARES];
-		copy_gadget_function(t, t_copy0, t_tmp0); copy_gadget_function(t_tmp0, t_copy1, t_tmp1); copy_gadget_function(t_tmp1, t_copy2, t_copy3);
-		
-		
-		//ciphertext[i]   = Multiply(2, state[i]   ^ state[i+1]) ^ state[i]   ^ t;
-		add_gadget_function(statei_copy1, statei1_copy1, tmp);
-		mult_cons_gadget_function(2, tmp, t);
-		add_gadget_function(statei_copy2, t, tmp);
-		add_gadget_function(tmp, t_copy0, ciphertext[ind_state[i]]);
-		
-		//ciphertext[i+1] = Multiply(2, state[i+1] ^ state[i+2]) ^ state[i+1] ^ t;
-		add_gadget_function(statei1_copy2, statei2_copy1, tmp);
-		mult_cons_gadget_function(2, tmp, t);
-		add_gadget_function(statei1_copy3, t, tmp);
-		add_gadget_function(tmp, t_copy1, ciphertext[ind_state[i+1]]);
-		
-		
-		//ciphertext[i+2] = Multiply(2, state[i+2] ^ state[i+3]) ^ state[i+2] ^ t;
-		add_gadget_function(statei2_copy2, statei3_copy1, tmp);
-		mult_cons_gadget_function(2, tmp, t);
-		add_gadget_function(statei2_copy3, t, tmp);
-		add_gadget_function(tmp, t_copy2, ciphertext[ind_state[i+2]]);
+/**********************************************************
+ * in : the 4 n-share bytes of a column
+ * out : the 4 n-share outputs (can be in)
+ * The column times P = circ(05, 00, 04, 00), the factor of
+ * InvMixColumns = MixColumns . P, which only mixes the 
+ * bytes k and k+2 of the column:
+ * out[k] = 05.in[k] + 04.in[k+2] = in[k] + 04.(in[k] + in[k+2])
+**********************************************************/
+static void inv_mix_column_p_kernel(uint8_t ** in, uint8_t ** out){
+	uint8_t * scratch = scratch_push(8);
+	
+	uint8_t * t = SCRATCH(0), * tmp = SCRATCH(1);
+	uint8_t * a_copy0 = SCRATCH(2), * a_copy1 = SCRATCH(3), * b_copy0 = SCRATCH(4), * b_copy1 = SCRATCH(5);
+	uint8_t * t_copy0 = SCRATCH(6), * t_copy1 = SCRATCH(7);
+	
+	for(int k = 0; k < 2; k++){
+		copy_gadget_function(in[k], a_copy0, a_copy1);
+		copy_gadget_function(in[k+2], b_copy0, b_copy1);
 		
+		//t = Multiply(4, state[k] ^ state[k+2]);
+		add_gadget_function(a_copy0, b_copy0, tmp);
+		mult_cons_gadget_function(4, tmp, t);
+		copy_gadget_function(t, t_copy0, t_copy1);
 		
-		//ciphertext[i+3] = Multiply(2, state[i+3] ^ state[i]  ) ^ state[i+3] ^ t;
-		add_gadget_function(statei3_copy2, statei_copy3, tmp);
-		mult_cons_gadget_function(2, tmp, t);
-		add_gadget_function(statei3_copy3, t, tmp);
-		add_gadget_function(tmp, t_copy3, ciphertext[ind_state[i+3]]);
+		add_gadget_function(a_copy1, t_copy0, out[k]);
+		add_gadget_function(b_copy1, t_copy1, out[k+2]);
 	}
+	
+	scratch_pop(8);
+}
+
+
+/**********************************************************
+ * in : the 4 n-share bytes of a column
+ * out : the 4 n-share outputs (can be in)
+ * rk : the 4 round key bytes added to the inputs, or NULL
+ * AddRoundKey and InvMixColumns on one column, computed as
+ * P and then the MixColumns kernel, which needs fewer 
+ * copies and constant multiplications than the direct
+ * InvMixColumns. The inputs are not modified.
+**********************************************************/
+static void inv_mix_column_kernel(uint8_t ** in, uint8_t ** out, uint8_t ** rk){
+	uint8_t * scratch = scratch_push(4);
+	uint8_t * x[4] = { SCRATCH(0), SCRATCH(1), SCRATCH(2), SCRATCH(3) };
+	
+	if(rk){
+		for(int k = 0; k < 4; k++){
+			add_gadget_function(in[k], rk[k], x[k]);
+		}
+		in = x;
+	}
+	inv_mix_column_p_kernel(in, x);
+	mix_column_kernel(x, out, NULL);
+	
+	scratch_pop(4);
+}
+
+
+void inv_mix_column_sharing(uint8_t ** state, uint8_t ** plaintext, uint8_t * ind_state, int i){
+	uint8_t * in[4] = { state[ind_state[i]], state[ind_state[i+1]], state[ind_state[i+2]], state[ind_state[i+3]] };
+	uint8_t * out[4] = { plaintext[ind_state[i]], plaintext[ind_state[i+1]], plaintext[ind_state[i+2]], plaintext[ind_state[i+3]] };
+	inv_mix_column_kernel(in, out, NULL);
 }
 
 
 void inv_mix_columns_sharing(uint8_t ** state, uint8_t ** plaintext, uint8_t * ind_state){
-	uint8_t t[NB_SHARES], u[NB_SHARES], v[NB_SHARES];
-	uint8_t tmp[NB_SHARES];
 	/*
 	* Inverse MixColumns
 	* [0e 0b 0d 09]   [s0  s4  s8  s12]
@@ -393,261 +536,263 @@ void inv_mix_columns_sharing(uint8_t ** state, uint8_t ** plaintext, uint8_t * i
 	* [0d 09 0e 0b]   [s2  s6  s10 s14]
 	* [0b 0d 09 0e]   [s3  s7  s11 s15]
 	*/
-	for (uint8_t i = 0; i < AES_BLOCK_SIZE; i+=4) {
-		uint8_t statei_copy0[NB_SHARES], statei_tmp0[NB_SHARES], statei_copy1[NB_SHARES], statei_tmp1[NB_SHARES],
-				statei_copy2[NB_SHARES], statei_tmp2[NB_SHARES], statei_copy3[NB_SHARES], statei_copy4[NB_SHARES];
-		copy_gadget_function(state[ind_state[i]], statei_copy0, statei_tmp0); copy_gadget_function(statei_tmp0, statei_copy1, statei_tmp1);
-		copy_gadget_function(statei_tmp1, statei_copy2, statei_tmp2); copy_gadget_function(statei_tmp2, statei_copy3, statei_copy4);
-		
-		uint8_t statei1_copy0[NB_SHARES], statei1_tmp0[NB_SHARES], statei1_copy1[NB_SHARES], statei1_tmp1[NB_SHARES],
-				statei1_copy2[NB_SHARES], statei1_tmp2[NB_SHARES], statei1_copy3[NB_SHARES], statei1_copy4[NB_SHARES];
-		copy_gadget_function(state[ind_state[i+1]], statei1_copy0, statei1_tmp0); copy_gadget_function(statei1_tmp0, statei1_copy1, statei1_tmp1);
-		copy_gadget_function(statei1_tmp1, statei1_copy2, statei1_tmp2); copy_gadget_function(statei1_tmp2, statei1_copy3, statei1_copy4);
-		
-		uint8_t statei2_copy0[NB_SHARES], statei2_tmp0[NB_SHARES], statei2_copy1[NB_SHARES], statei2_tmp1[NB_SHARES],
-				statei2_copy2[NB_SHARES], statei2_tmp2[NB_SHARES], statei2_copy3[NB_SHARES], statei2_copy4[NB_SHARES];
-		copy_gadget_function(state[ind_state[i+2]], statei2_copy0, statei2_tmp0); copy_gadget_function(statei2_tmp0, statei2_copy1, statei2_tmp1);
-		copy_gadget_function(statei2_tmp1, statei2_copy2, statei2_tmp2); copy_gadget_function(statei2_tmp2, statei2_copy3, statei2_copy4);
-		
-		uint8_t statei3_copy0[NB_SHARES], statei3_tmp0[NB_SHARES], statei3_copy1[NB_SHARES], statei3_tmp1[NB_SHARES],
-				statei3_copy2[NB_SHARES], statei3_tmp2[NB_SHARES], statei3_copy3[NB_SHARES], statei3_copy4[NB_SHARES];
-		copy_gadget_function(state[ind_state[i+3]], statei3_copy0, statei3_tmp0); copy_gadget_function(statei3_tmp0, statei3_copy1, statei3_tmp1);
-		copy_gadget_function(statei3_tmp1, statei3_copy2, statei3_tmp2); copy_gadget_function(statei3_tmp2, statei3_copy3, statei3_copy4);
-		
-		
-		//t = state[i] ^ state[i+1] ^ state[i+2] ^ state[i+3];
-		add_gadget_function(statei_copy0, statei1_copy0, t);
-		add_gadget_function(statei2_copy0, t, tmp);
-		add_gadget_function(statei3_copy0, tmp, t);
-		
-		uint8_t t_copy0[NB_SHARES], t_tmp0[NB_SHARES], t_copy1[NB_SHARES], t_tmp1[NB_SHARES], t_copy2[NB_SHARES], t_copy3[NB_SHARES];
-		copy_gadget_function(t, t_copy0, t_tmp0); copy_gadget_function(t_tmp0, t_copy1, t_tmp1); copy_gadget_function(t_tmp1, t_copy2, t_copy3);
-		
-		//plaintext[i]   = t ^ state[i]   ^ mul2(state[i]   ^ state[i+1]);
-		add_gadget_function(statei_copy1, statei1_copy1, tmp);
-		mult_cons_gadget_function(2, tmp, t);
-		add_gadget_function(statei_copy2, t, tmp);
-		add_gadget_function(tmp, t_copy0, plaintext[ind_state[i]]);
-		
-		//plaintext[i+1] = t ^ state[i+1] ^ mul2(state[i+1] ^ state[i+2]);
-		add_gadget_function(statei1_copy2, statei2_copy1, tmp);
-		mult_cons_gadget_function(2, tmp, t);
-		add_gadget_function(statei1_copy3, t, tmp);
-		add_gadget_function(tmp, t_copy1, plaintext[ind_state[i+1]]);
-		
-		
-		//plaintext[i+2] = t ^ state[i+2] ^ mul2(state[i+2] ^ state[i+3]);
-		add_gadget_function(statei2_copy2, statei3_copy1, tmp);
-		mult_cons_gadget_function(2, tmp, t);
-		add_gadget_function(statei2_copy3, t, tmp);
-		add_gadget_function(tmp, t_copy2, plaintext[ind_state[i+2]]);
-		
-		
-		//plaintext[i+3] = t ^ state[i+3] ^ mul2(state[i+3] ^ state[i]);
-		add_gadget_function(statei3_copy2, statei_copy3, tmp);
-		mult_cons_gadget_function(2, tmp, t);
-		add_gadget_function(statei3_copy3, t, tmp);
-		add_gadget_function(tmp, t_copy3, plaintext[ind_state[i+3]]);
-		
-		
-		//u = Multiply(2, Multiply(2, (state[i]   ^ state[i+2])) );
-		add_gadget_function(statei_copy4, statei2_copy4, tmp);
-		mult_cons_gadget_function(2, tmp, t);
-		mult_cons_gadget_function(2, t, u);
-		
-		//v = Multiply(2, Multiply(2, (state[i+1] ^ state[i+3])) );
-		add_gadget_function(statei1_copy4, statei3_copy4, tmp);
-		mult_cons_gadget_function(2, tmp, t);
-		mult_cons_gadget_function(2, t, v);
-		
-		uint8_t u_copy0[NB_SHARES], u_tmp0[NB_SHARES], u_copy1[NB_SHARES], u_copy2[NB_SHARES];
-		copy_gadget_function(u, u_copy0, u_tmp0); copy_gadget_function(u_tmp0, u_copy1, u_copy2);
-		
-		uint8_t v_copy0[NB_SHARES], v_tmp0[NB_SHARES], v_copy1[NB_SHARES], v_copy2[NB_SHARES];
-		copy_gadget_function(v, v_copy0, v_tmp0); copy_gadget_function(v_tmp0, v_copy1, v_copy2);
-		
-		//t = Multiply(2, (u ^ v));    
-		add_gadget_function(u_copy0, v_copy0, tmp);
-		mult_cons_gadget_function(2, tmp, t);
-		
-		copy_gadget_function(t, t_copy0, t_tmp0); copy_gadget_function(t_tmp0, t_copy1, t_tmp1); copy_gadget_function(t_tmp1, t_copy2, t_copy3);
-		
-		//plaintext[i]   ^= t ^ u;
-		add_gadget_function(plaintext[ind_state[i]], t_copy0, tmp);
-		add_gadget_function(u_copy1, tmp, plaintext[ind_state[i]]);
-		
-		//plaintext[i+1] ^= t ^ v;
-		add_gadget_function(plaintext[ind_state[i+1]], t_copy1, tmp);
-		add_gadget_function(v_copy1, tmp, plaintext[ind_state[i+1]]);
+	for (int i = 0; i < AES_BLOCK_SIZE; i+=4) {
+		inv_mix_column_sharing(state, plaintext, ind_state, i);
+	}
+}
+
+
+/**********************************************************
+ * The rounds work in place: the gadgets, the S-boxes and
+ * mix_columns_sharing all accept an output that is their
+ * input, so the state never goes through temporary 
+ * arrays. The only copy is the return to the natural
+ * order of the bytes, which is folded into the last
+ * AddRoundKey of aes_encrypt_round_sharing.
+**********************************************************/
+static void encrypt_round(uint8_t **roundkeys, int round, uint8_t **state, uint8_t *ind_state){
+	int ind_roundkeys = round * AES_BLOCK_SIZE;
+	int i;
+	
+	// SubBytes
+	for (i = 0; i < AES_BLOCK_SIZE; ++i) {
+		get_sbox_value_sharing(state[ind_state[i]], state[ind_state[i]]);
+	}
+	PERF_TRACE_END(round, PERF_PHASE_SUB_BYTES);
+	
+	shift_rows_sharing(state, ind_state);
+	PERF_TRACE_END(round, PERF_PHASE_SHIFT_ROWS);
+	
+	if(round < AES_ROUNDS){
+		/*
+		 * MixColumns 
+		 * [02 03 01 01]   [s0  s4  s8  s12]
+		 * [01 02 03 01] . [s1  s5  s9  s13]
+		 * [01 01 02 03]   [s2  s6  s10 s14]
+		 * [03 01 01 02]   [s3  s7  s11 s15]
+		 */
+		mix_columns_sharing(state, state, ind_state);
+		PERF_TRACE_END(round, PERF_PHASE_MIX_COLUMNS);
+		
+		// AddRoundKey
+		for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
+			add_gadget_function(state[ind_state[i]], roundkeys[ind_roundkeys], state[ind_state[i]]);
+			ind_roundkeys++;
+		}
+		PERF_TRACE_END(round, PERF_PHASE_ADD_ROUND_KEY);
+	}
+}
+
+
+void aes_encrypt_round_sharing(uint8_t **roundkeys, int round, uint8_t **block, uint8_t *ind_state){
+	
+	int i;
+	
+	// the rounds of a block can run on different threads (pipeline stages)
+	PERF_TRACE_BEGIN();
+	
+	if(round == 0){
+		// first AddRoundKey
+		for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
+			add_gadget_function(block[ind_state[i]], roundkeys[i], block[ind_state[i]]);
+		}
+		PERF_TRACE_END(0, PERF_PHASE_ADD_ROUND_KEY);
+		return;
+	}
+	
+	encrypt_round(roundkeys, round, block, ind_state);
+	
+	if(round == AES_ROUNDS){
+		// last AddRoundKey, and back to the natural order of the bytes
+		uint8_t * scratch = scratch_push(AES_BLOCK_SIZE);
+		for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
+			add_gadget_function(block[ind_state[i]], roundkeys[AES_ROUNDS * AES_BLOCK_SIZE + i], SCRATCH(i));
+		}
+		for(i=0; i< AES_BLOCK_SIZE; i++){
+			memcpy(block[i], SCRATCH(i), NB_SHARES*sizeof(uint8_t));
+			ind_state[i] = i;
+		}
+		scratch_pop(AES_BLOCK_SIZE);
+		PERF_TRACE_END(AES_ROUNDS, PERF_PHASE_ADD_ROUND_KEY);
+	}
+}
+
+
+/**********************************************************
+ * ShiftRows as a byte permutation fixed at compile time:
+ * byte i of the shifted state is byte shift_rows_index[i]
+ * of the state, and InvShiftRows moves byte i of the 
+ * state to shift_rows_index[i].
+ * 
+ * aes_encrypt_128_sharing and aes_decrypt_128_sharing use
+ * it instead of ind_state: ShiftRows is folded into the 
+ * indexing of the MixColumns inputs (resp. InvShiftRows 
+ * into the InvMixColumns outputs), and AddRoundKey into 
+ * the MixColumns outputs (resp. the InvMixColumns 
+ * inputs), so that a round is two passes over the state
+ * (SubBytes in place, then the fused kernel from one 
+ * state buffer to the other). inv_shift_rows_index is 
+ * the inverse permutation, for the equivalent inverse 
+ * cipher that gathers its columns like the cipher.
+**********************************************************/
+static const uint8_t shift_rows_index[AES_BLOCK_SIZE] = {
+	0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12, 1, 6, 11
+};
+
+
+static const uint8_t inv_shift_rows_index[AES_BLOCK_SIZE] = {
+	0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3
+};
+
+
+/**********************************************************
+ * The rounds of aes_encrypt_128_sharing, also used by 
+ * aes_decrypt_128_sharing_eq (inverse set): the equivalent
+ * inverse cipher has the structure of the cipher, with 
+ * the inverse S-box, InvShiftRows (inv_shift_rows_index)
+ * and InvMixColumns as P then the MixColumns kernel, with
+ * the InvMixColumns of the round keys precomputed by 
+ * aes_inv_roundkeys_sharing.
+**********************************************************/
+static void cipher_rounds(uint8_t **roundkeys, uint8_t **in_block, uint8_t **out_block, int inverse){
+	
+	void (*sbox)(uint8_t *, uint8_t *) = inverse ? get_inv_sbox_value_sharing : get_sbox_value_sharing;
+	const uint8_t * index = inverse ? inv_shift_rows_index : shift_rows_index;
+	uint8_t * scratch = scratch_push(2 * AES_BLOCK_SIZE);
+	uint8_t * buffers[2][AES_BLOCK_SIZE];
+	uint8_t ** state = buffers[0], ** next = buffers[1], ** swap;
+	uint8_t * in[4], * out[4];
+	int i, j, c;
+	
+	for(i=0; i< AES_BLOCK_SIZE; i++){
+		buffers[0][i] = SCRATCH(i);
+		buffers[1][i] = SCRATCH(AES_BLOCK_SIZE + i);
+	}
+	
+	PERF_TRACE_BEGIN();
+	
+	// first AddRoundKey
+	for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
+		add_gadget_function(in_block[i], roundkeys[i], state[i]);
+	}
+	PERF_TRACE_END(0, PERF_PHASE_ADD_ROUND_KEY);
+	
+	for (j = 1; j < AES_ROUNDS; ++j) {
+		// SubBytes
+		for (i = 0; i < AES_BLOCK_SIZE; ++i) {
+			sbox(state[i], state[i]);
+		}
+		PERF_TRACE_END(j, PERF_PHASE_SUB_BYTES);
 		
-		//plaintext[i+2] ^= t ^ u;
-		add_gadget_function(plaintext[ind_state[i+2]], t_copy2, tmp);
-		add_gadget_function(u_copy2, tmp, plaintext[ind_state[i+2]]);
+		// ShiftRows, MixColumns and AddRoundKey
+		for (c = 0; c < AES_BLOCK_SIZE; c += 4) {
+			for (i = 0; i < 4; i++) {
+				in[i] = state[index[c + i]];
+				out[i] = next[c + i];
+			}
+			// the state is not read anymore, P can be in place
+			if(inverse)
+				inv_mix_column_p_kernel(in, in);
+			mix_column_kernel(in, out, roundkeys + j * AES_BLOCK_SIZE + c);
+		}
+		PERF_TRACE_END(j, PERF_PHASE_MIX_COLUMNS);
 		
-		//plaintext[i+3] ^= t ^ v;
-		add_gadget_function(plaintext[ind_state[i+3]], t_copy3, tmp);
-		add_gadget_function(v_copy2, tmp, plaintext[ind_state[i+3]]);
+		swap = state;
+		state = next;
+		next = swap;
 	}
-        
-
+	
+	// last round: SubBytes, then ShiftRows and AddRoundKey into the output
+	for (i = 0; i < AES_BLOCK_SIZE; ++i) {
+		sbox(state[i], state[i]);
+	}
+	PERF_TRACE_END(AES_ROUNDS, PERF_PHASE_SUB_BYTES);
+	
+	for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
+		add_gadget_function(state[index[i]], roundkeys[AES_ROUNDS * AES_BLOCK_SIZE + i], out_block[i]);
+	}
+	PERF_TRACE_END(AES_ROUNDS, PERF_PHASE_ADD_ROUND_KEY);
+	
+	scratch_pop(2 * AES_BLOCK_SIZE);
 }
 
 
 void aes_encrypt_128_sharing(uint8_t **roundkeys, uint8_t **plaintext, uint8_t **ciphertext){
-	
-	uint8_t ** state = (uint8_t **)malloc(AES_BLOCK_SIZE * sizeof(uint8_t *));
-	uint8_t ind_state[AES_BLOCK_SIZE];
-	for(int i=0; i< AES_BLOCK_SIZE; i++){
-		state[i] = (uint8_t *)malloc(NB_SHARES * sizeof(uint8_t));
-		ind_state[i] = i;
-	}	
-	uint8_t tmp[NB_SHARES];
-    uint8_t i, j;
-
-	int ind_roundkeys = 0;
-	int ind;
-
-    // first AddRoundKey
-    for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
-		add_gadget_function(plaintext[i], roundkeys[ind_roundkeys], ciphertext[i]);
-        ind_roundkeys++;
-    }
-
-    // 9 rounds
-    for (j = 1; j < AES_ROUNDS; ++j) {
-
-        // SubBytes
-        for (i = 0; i < AES_BLOCK_SIZE; ++i) {
-			get_sbox_value_sharing(ciphertext[ind_state[i]], state[ind_state[i]]);
-        }
-        
-        shift_rows_sharing(state, ind_state);
-        /*
-         * MixColumns 
-         * [02 03 01 01]   [s0  s4  s8  s12]
-         * [01 02 03 01] . [s1  s5  s9  s13]
-         * [01 01 02 03]   [s2  s6  s10 s14]
-         * [03 01 01 02]   [s3  s7  s11 s15]
-         */
-         mix_columns_sharing(state, ciphertext, ind_state);
-
-        // AddRoundKey
-        for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
-			
-			add_gadget_function(ciphertext[ind_state[i]], roundkeys[ind_roundkeys], tmp);
-			ind_roundkeys++;
-            for(ind=0; ind<NB_SHARES; ind++){
-				ciphertext[ind_state[i]][ind] = tmp[ind];
+	cipher_rounds(roundkeys, plaintext, ciphertext, 0);
+}
+
+
+void aes_inv_roundkeys_sharing(uint8_t **roundkeys, uint8_t **inv_roundkeys){
+	for(int j = 0; j <= AES_ROUNDS; j++){
+		uint8_t ** rk = roundkeys + (AES_ROUNDS - j) * AES_BLOCK_SIZE;
+		uint8_t ** dk = inv_roundkeys + j * AES_BLOCK_SIZE;
+		
+		if(j == 0 || j == AES_ROUNDS){
+			for(int i = 0; i < AES_BLOCK_SIZE; i++){
+				memcpy(dk[i], rk[i], NB_SHARES*sizeof(uint8_t));
+			}
+		}
+		else{
+			for(int c = 0; c < AES_BLOCK_SIZE; c += 4){
+				inv_mix_column_kernel(rk + c, dk + c, NULL);
 			}
-        }
-    }
-
-    // last round
-    for (i = 0; i < AES_BLOCK_SIZE; ++i) {
-        get_sbox_value_sharing(ciphertext[ind_state[i]], tmp);
-        for(ind=0; ind<NB_SHARES; ind++){
-			ciphertext[ind_state[i]][ind] = tmp[ind];
 		}
-    }
-    
-    shift_rows_sharing(ciphertext, ind_state);
-    
-    for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
-		add_gadget_function(ciphertext[ind_state[i]], roundkeys[ind_roundkeys], state[ind_state[i]]);
-		ind_roundkeys++;
-    }
-    
-    for(i=0; i< AES_BLOCK_SIZE; i++){
-		/*for(ind =0; ind< NB_SHARES; ind++){
-			ciphertext[i][ind] = state[ind_state[i]][ind];
-		}*/
-		memcpy(ciphertext[i], state[ind_state[i]], NB_SHARES*sizeof(uint8_t));
 	}
-    
-    for(i=0; i< AES_BLOCK_SIZE; i++){
-		free(state[i]);
-	}	
-	free(state);
 }
 
 
+void aes_decrypt_128_sharing_eq(uint8_t **inv_roundkeys, uint8_t **ciphertext, uint8_t **plaintext){
+	cipher_rounds(inv_roundkeys, ciphertext, plaintext, 1);
+}
 
 
 void aes_decrypt_128_sharing(uint8_t **roundkeys, uint8_t **ciphertext, uint8_t **plaintext){
 	
+	uint8_t * scratch = scratch_push(2 * AES_BLOCK_SIZE);
+	uint8_t * buffers[2][AES_BLOCK_SIZE];
+	uint8_t ** state = buffers[0], ** next = buffers[1], ** swap;
+	uint8_t * in[4], * out[4];
+	int i, j, c;
 	
-	uint8_t ** state = (uint8_t **)malloc(AES_BLOCK_SIZE * sizeof(uint8_t *));
-	uint8_t ind_state[AES_BLOCK_SIZE];
-	for(int i=0; i< AES_BLOCK_SIZE; i++){
-		state[i] = (uint8_t *)malloc(NB_SHARES * sizeof(uint8_t));
-		ind_state[i] = i;
-	}	
-	uint8_t tmp[NB_SHARES];
-    uint8_t i, j;
-
-	int ind_roundkeys = 160;
-	int ind;
-
-    // first Round
-    for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
-		add_gadget_function(ciphertext[ind_state[i]], roundkeys[ind_roundkeys], plaintext[ind_state[i]]);
-        ind_roundkeys++;
-    }
-    ind_roundkeys -= 32;
-    inv_shift_rows_sharing(plaintext, ind_state);
-    
-    // Inverse SubBytes
+	for(i=0; i< AES_BLOCK_SIZE; i++){
+		buffers[0][i] = SCRATCH(i);
+		buffers[1][i] = SCRATCH(AES_BLOCK_SIZE + i);
+	}
+	
+	// first AddRoundKey and InvShiftRows, then Inverse SubBytes
+	for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
+		add_gadget_function(ciphertext[i], roundkeys[AES_ROUNDS * AES_BLOCK_SIZE + i], state[shift_rows_index[i]]);
+	}
 	for (i = 0; i < AES_BLOCK_SIZE; ++i) {
-		get_inv_sbox_value_sharing(plaintext[ind_state[i]], plaintext[ind_state[i]]);
+		get_inv_sbox_value_sharing(state[i], state[i]);
 	}
-
-    // 9 rounds
-    for (j = 1; j < AES_ROUNDS; ++j) {
+	
+	// 9 rounds
+	for (j = AES_ROUNDS - 1; j > 0; --j) {
+		
+		// AddRoundKey, Inverse MixColumns and Inverse ShiftRows
+		for (c = 0; c < AES_BLOCK_SIZE; c += 4) {
+			for (i = 0; i < 4; i++) {
+				in[i] = state[c + i];
+				out[i] = next[shift_rows_index[c + i]];
+			}
+			inv_mix_column_kernel(in, out, roundkeys + j * AES_BLOCK_SIZE + c);
+		}
+		
+		swap = state;
+		state = next;
+		next = swap;
 		
-		// Inverse AddRoundKey
-        for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
-			add_gadget_function(plaintext[ind_state[i]], roundkeys[ind_roundkeys], state[ind_state[i]]);
-			ind_roundkeys++;
-        }
-        ind_roundkeys -= 32;
-        
-        /*
-         * Inverse MixColumns
-         * [0e 0b 0d 09]   [s0  s4  s8  s12]
-         * [09 0e 0b 0d] . [s1  s5  s9  s13]
-         * [0d 09 0e 0b]   [s2  s6  s10 s14]
-         * [0b 0d 09 0e]   [s3  s7  s11 s15]
-         */
-         inv_mix_columns_sharing(state, plaintext, ind_state);
-         
-         // Inverse ShiftRows
-         inv_shift_rows_sharing(plaintext, ind_state);
-         
-         
 		// Inverse SubBytes
 		for (i = 0; i < AES_BLOCK_SIZE; ++i) {
-			get_inv_sbox_value_sharing(plaintext[ind_state[i]], plaintext[ind_state[i]]);
+			get_inv_sbox_value_sharing(state[i], state[i]);
 		}
-		
-    }
-    
-    // last AddRoundKey
-    for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
-		add_gadget_function(plaintext[ind_state[i]], roundkeys[ind_roundkeys], state[ind_state[i]]);
-		ind_roundkeys++;
-    }
-    
-    
-    for(i=0; i< AES_BLOCK_SIZE; i++){
-		/*for(ind =0; ind< NB_SHARES; ind++){
-			ciphertext[i][ind] = state[ind_state[i]][ind];
-		}*/
-		memcpy(plaintext[i], state[ind_state[i]], NB_SHARES*sizeof(uint8_t));
 	}
-    
-    for(i=0; i< AES_BLOCK_SIZE; i++){
-		free(state[i]);
-	}	
-	free(state);
 	
+	// last AddRoundKey
+	for ( i = 0; i < AES_BLOCK_SIZE; ++i ) {
+		add_gadget_function(state[i], roundkeys[i], plaintext[i]);
+	}
+	
+	scratch_pop(2 * AES_BLOCK_SIZE);
 }
@@ -56,6 +56,19 @@
 
 void exp254_sharing(uint8_t *x, uint8_t * out);
 
+/**********************************************************
+ * The S-box and its inverse as polynomials (x^254 and 
+ * the affine function). out can be x.
+**********************************************************/
+void get_sbox_value_sharing_poly(uint8_t * x, uint8_t * out);
+
+void get_inv_sbox_value_sharing_poly(uint8_t * x, uint8_t * out);
+
+/**********************************************************
+ * The S-box used by the cipher: the table recomputation
+ * of sbox_table_sharing.h at low orders, the polynomial
+ * otherwise (out can be x)
+**********************************************************/
 void get_sbox_value_sharing(uint8_t * x, uint8_t * out);
 
 void get_inv_sbox_value_sharing(uint8_t * x, uint8_t * out);
@@ -68,18 +81,65 @@ void get_inv_sbox_value_sharing(uint8_t * x, uint8_t * out);
  * and copying whole arrays, we use dynamic indexing with
  * the variable ind_state and lightly tweak the code of
  * the AES encryption and decryption functions to use
- * ind_state.
+ * ind_state. aes_encrypt_128_sharing and 
+ * aes_decrypt_128_sharing fold ShiftRows into MixColumns
+ * instead (see aes128_sharing.c); ind_state is kept for
+ * the round by round and column by column interfaces.
 **********************************************************/
 void shift_rows_sharing(uint8_t ** state, uint8_t * ind_state);
 
 void inv_shift_rows_sharing(uint8_t ** state, uint8_t * ind_state);
 
+/**********************************************************
+ * The inputs of a column are only read before any output
+ * of the column is written, so ciphertext (resp. 
+ * plaintext) can be state
+**********************************************************/
 void mix_columns_sharing(uint8_t ** state, uint8_t ** ciphertext, uint8_t * ind_state);
 
 void inv_mix_columns_sharing(uint8_t ** state, uint8_t ** plaintext, uint8_t * ind_state);
 
+/**********************************************************
+ * i : first byte of the column (0, 4, 8 or 12)
+ * MixColumns (resp. its inverse) on the single column i.
+ * The four columns are independent, so that they can be
+ * computed by different threads (see aes128_team.h)
+**********************************************************/
+void mix_column_sharing(uint8_t ** state, uint8_t ** ciphertext, uint8_t * ind_state, int i);
+
+void inv_mix_column_sharing(uint8_t ** state, uint8_t ** plaintext, uint8_t * ind_state, int i);
+
+/**********************************************************
+ * round : 0 (first AddRoundKey) to AES_ROUNDS
+ * block : the 16 n-share bytes of the state, in place
+ * ind_state : ShiftRows indirection of block (identity
+ * before round 0, updated by each round, and back to the
+ * identity after the last round)
+ * One round of aes_encrypt_128_sharing, so that the 
+ * rounds of a block can be run by different threads
+ * (see aes128_pipeline.h)
+**********************************************************/
+void aes_encrypt_round_sharing(uint8_t **roundkeys, int round, uint8_t **block, uint8_t *ind_state);
+
 void aes_encrypt_128_sharing(uint8_t **roundkeys, uint8_t **plaintext, uint8_t **ciphertext);
 
 void aes_decrypt_128_sharing(uint8_t **roundkeys, uint8_t **ciphertext, uint8_t **plaintext);
 
+/**********************************************************
+ * The equivalent inverse cipher (FIPS-197, 5.3.5): the 
+ * rounds of aes_encrypt_128_sharing with the inverse 
+ * S-box and InvMixColumns, and AddRoundKey after 
+ * InvMixColumns with the round keys of
+ * aes_inv_roundkeys_sharing (in the reverse order, 
+ * InvMixColumns applied to the round keys 1 to 9). 
+ * The transformation is done once per key, so that
+ * aes_decrypt_128_sharing_eq has the cost of the 
+ * encryption plus P (see aes128_sharing.c) in each round.
+ * inv_roundkeys : AES_ROUND_KEY_SIZE n-share bytes, 
+ * distinct from roundkeys
+**********************************************************/
+void aes_inv_roundkeys_sharing(uint8_t **roundkeys, uint8_t **inv_roundkeys);
+
+void aes_decrypt_128_sharing_eq(uint8_t **inv_roundkeys, uint8_t **ciphertext, uint8_t **plaintext);
+
 #endif
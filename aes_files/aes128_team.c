@@ -0,0 +1,272 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "aes128_team.h"
+
+#include "gadgets.h"
+#include "parallel.h"
+
+
+typedef struct {
+	aes_team * team;
+	int id;
+	int sense;                    // of spin_barrier_wait
+	pthread_t thread;
+} team_member;
+
+
+struct aes_team {
+	int nb_threads;
+	team_member members[AES_BLOCK_SIZE];
+	spin_barrier barrier;
+	
+	// the helpers wait for a new generation (one per block)
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	unsigned long generation;
+	int quit;
+	
+	// current block
+	uint8_t ** roundkeys;
+	int decrypt;
+	uint8_t state_shares[AES_BLOCK_SIZE][NB_SHARES];
+	uint8_t * state[AES_BLOCK_SIZE];
+};
+
+
+/**********************************************************
+ * Part of member id in rounds 1 to AES_ROUNDS. The first
+ * and the last AddRoundKey are done by the calling thread
+ * before and after. On return, ind_state is the 
+ * indirection after the last round
+**********************************************************/
+static void encrypt_rounds(aes_team * team, team_member * m, uint8_t * ind_state){
+	uint8_t ** state = team->state;
+	int nb = team->nb_threads;
+	int round, i, k;
+	
+	for(round = 1; round <= AES_ROUNDS; round++){
+		// SubBytes
+		for(i = m->id; i < AES_BLOCK_SIZE; i += nb){
+			get_sbox_value_sharing(state[ind_state[i]], state[ind_state[i]]);
+		}
+		spin_barrier_wait(&team->barrier, &m->sense);
+		
+		shift_rows_sharing(state, ind_state);
+		
+		if(round < AES_ROUNDS){
+			// MixColumns and AddRoundKey, by column
+			for(i = 4 * m->id; i < AES_BLOCK_SIZE; i += 4 * nb){
+				mix_column_sharing(state, state, ind_state, i);
+				for(k = i; k < i + 4; k++){
+					add_gadget_function(state[ind_state[k]], team->roundkeys[round * AES_BLOCK_SIZE + k], state[ind_state[k]]);
+				}
+			}
+			spin_barrier_wait(&team->barrier, &m->sense);
+		}
+	}
+}
+
+
+static void decrypt_rounds(aes_team * team, team_member * m, uint8_t * ind_state){
+	uint8_t ** state = team->state;
+	int nb = team->nb_threads;
+	int round, i, k;
+	
+	for(round = AES_ROUNDS; round >= 1; round--){
+		if(round < AES_ROUNDS){
+			// Inverse AddRoundKey and Inverse MixColumns, by column
+			for(i = 4 * m->id; i < AES_BLOCK_SIZE; i += 4 * nb){
+				for(k = i; k < i + 4; k++){
+					add_gadget_function(state[ind_state[k]], team->roundkeys[round * AES_BLOCK_SIZE + k], state[ind_state[k]]);
+				}
+				inv_mix_column_sharing(state, state, ind_state, i);
+			}
+			spin_barrier_wait(&team->barrier, &m->sense);
+		}
+		
+		inv_shift_rows_sharing(state, ind_state);
+		
+		// Inverse SubBytes
+		for(i = m->id; i < AES_BLOCK_SIZE; i += nb){
+			get_inv_sbox_value_sharing(state[ind_state[i]], state[ind_state[i]]);
+		}
+		spin_barrier_wait(&team->barrier, &m->sense);
+	}
+}
+
+
+static void run_block(aes_team * team, team_member * m, uint8_t * ind_state){
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		ind_state[i] = i;
+	}
+	if(team->decrypt)
+		decrypt_rounds(team, m, ind_state);
+	else
+		encrypt_rounds(team, m, ind_state);
+}
+
+
+static void * run_helper(void * arg){
+	team_member * m = (team_member *)arg;
+	aes_team * team = m->team;
+	unsigned long generation = 0;
+	uint8_t ind_state[AES_BLOCK_SIZE];
+	
+	for(;;){
+		pthread_mutex_lock(&team->lock);
+		while(team->generation == generation && !team->quit){
+			pthread_cond_wait(&team->start, &team->lock);
+		}
+		generation = team->generation;
+		if(team->quit){
+			pthread_mutex_unlock(&team->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&team->lock);
+		
+		run_block(team, m, ind_state);
+	}
+}
+
+
+aes_team * aes_team_new(int nb_threads){
+	aes_team * team = (aes_team *)calloc(1, sizeof(aes_team));
+	if(!team)
+		return NULL;
+	
+	if(nb_threads < 1)
+		nb_threads = 1;
+	if(nb_threads > AES_BLOCK_SIZE)
+		nb_threads = AES_BLOCK_SIZE;
+	
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		team->state[i] = team->state_shares[i];
+	}
+	pthread_mutex_init(&team->lock, NULL);
+	pthread_cond_init(&team->start, NULL);
+	
+	// the helpers only read nb_threads once a block is started
+	team->nb_threads = 1;
+	team->members[0].team = team;
+	for(int t = 1; t < nb_threads; t++){
+		team->members[t].team = team;
+		team->members[t].id = t;
+		if(pthread_create(&team->members[t].thread, NULL, run_helper, &team->members[t]) != 0)
+			break;
+		team->nb_threads++;
+	}
+	spin_barrier_init(&team->barrier, team->nb_threads);
+	return team;
+}
+
+
+void aes_team_free(aes_team * team){
+	if(!team)
+		return;
+	
+	pthread_mutex_lock(&team->lock);
+	team->quit = 1;
+	pthread_cond_broadcast(&team->start);
+	pthread_mutex_unlock(&team->lock);
+	
+	for(int t = 1; t < team->nb_threads; t++){
+		pthread_join(team->members[t].thread, NULL);
+	}
+	pthread_cond_destroy(&team->start);
+	pthread_mutex_destroy(&team->lock);
+	free(team);
+}
+
+
+int aes_team_size(aes_team * team){
+	return team->nb_threads;
+}
+
+
+/**********************************************************
+ * Starts the block on the helpers and runs the part of
+ * the calling thread (member 0). The last barrier of the
+ * rounds ensures that all the helpers are done
+**********************************************************/
+static void run_team(aes_team * team, uint8_t * ind_state){
+	if(team->nb_threads > 1){
+		pthread_mutex_lock(&team->lock);
+		team->generation++;
+		pthread_cond_broadcast(&team->start);
+		pthread_mutex_unlock(&team->lock);
+	}
+	run_block(team, &team->members[0], ind_state);
+}
+
+
+void aes_encrypt_128_sharing_team(aes_team * team, uint8_t **roundkeys, uint8_t **plaintext, uint8_t **ciphertext){
+	uint8_t ind_state[AES_BLOCK_SIZE];
+	int i;
+	
+	team->roundkeys = roundkeys;
+	team->decrypt = 0;
+	
+	// first AddRoundKey
+	for(i = 0; i < AES_BLOCK_SIZE; i++){
+		add_gadget_function(plaintext[i], roundkeys[i], team->state[i]);
+	}
+	
+	run_team(team, ind_state);
+	
+	// last AddRoundKey, written in the natural order of the bytes
+	for(i = 0; i < AES_BLOCK_SIZE; i++){
+		add_gadget_function(team->state[ind_state[i]], roundkeys[AES_ROUNDS * AES_BLOCK_SIZE + i], ciphertext[i]);
+	}
+}
+
+
+void aes_decrypt_128_sharing_team(aes_team * team, uint8_t **roundkeys, uint8_t **ciphertext, uint8_t **plaintext){
+	uint8_t ind_state[AES_BLOCK_SIZE];
+	int i;
+	
+	team->roundkeys = roundkeys;
+	team->decrypt = 1;
+	
+	// first AddRoundKey
+	for(i = 0; i < AES_BLOCK_SIZE; i++){
+		add_gadget_function(ciphertext[i], roundkeys[AES_ROUNDS * AES_BLOCK_SIZE + i], team->state[i]);
+	}
+	
+	run_team(team, ind_state);
+	
+	// last AddRoundKey, written in the natural order of the bytes
+	for(i = 0; i < AES_BLOCK_SIZE; i++){
+		add_gadget_function(team->state[ind_state[i]], roundkeys[i], plaintext[i]);
+	}
+}
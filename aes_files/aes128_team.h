@@ -0,0 +1,84 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+
+#ifndef AES128_TEAM_H
+#define AES128_TEAM_H
+
+#include "aes128_sharing.h"
+
+/**********************************************************
+ * Low latency mode for the encryption of single blocks at
+ * high orders.
+ * 
+ * In each round, the 16 S-boxes (and the 4 columns of
+ * MixColumns, with their AddRoundKey) of one block are
+ * independent: a team of nb_threads threads (the calling
+ * thread and nb_threads - 1 helpers) shares them, the
+ * S-box i going to thread i % nb_threads, and the threads
+ * meet at a spin barrier after SubBytes and after 
+ * MixColumns. Each thread follows ShiftRows on its own
+ * copy of the indirection, so ShiftRows costs no barrier.
+ * 
+ * This divides the latency of a block by up to 
+ * nb_threads (at most AES_BLOCK_SIZE) when the S-boxes 
+ * dominate, i.e. for large NB_SHARES. For throughput on
+ * many blocks, aes_encrypt_128_sharing_batch is better.
+ * 
+ * The helpers are created once with the team and sleep 
+ * between blocks. A team runs one block at a time, so it
+ * must not be used by several threads at once.
+**********************************************************/
+
+typedef struct aes_team aes_team;
+
+
+/**********************************************************
+ * nb_threads : size of the team, calling thread included
+ * (1 to AES_BLOCK_SIZE). If some helpers cannot be 
+ * created, the team is smaller (see aes_team_size).
+ * Returns NULL if out of memory
+**********************************************************/
+aes_team * aes_team_new(int nb_threads);
+
+void aes_team_free(aes_team * team);
+
+int aes_team_size(aes_team * team);
+
+
+/**********************************************************
+ * Same as aes_encrypt_128_sharing and 
+ * aes_decrypt_128_sharing, the block being computed by 
+ * the team
+**********************************************************/
+void aes_encrypt_128_sharing_team(aes_team * team, uint8_t **roundkeys, uint8_t **plaintext, uint8_t **ciphertext);
+
+void aes_decrypt_128_sharing_team(aes_team * team, uint8_t **roundkeys, uint8_t **ciphertext, uint8_t **plaintext);
+
+#endif
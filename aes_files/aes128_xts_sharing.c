@@ -0,0 +1,114 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "aes128_xts_sharing.h"
+#include "gadgets.h"
+
+
+void xts_mult_alpha_sharing(uint8_t * t){
+	for(int s = 0; s < NB_SHARES; s++){
+		uint8_t carry = t[(AES_BLOCK_SIZE - 1) * NB_SHARES + s] >> 7;
+		for(int i = AES_BLOCK_SIZE - 1; i > 0; i--){
+			t[i * NB_SHARES + s] = (t[i * NB_SHARES + s] << 1) | (t[(i - 1) * NB_SHARES + s] >> 7);
+		}
+		t[s] = (t[s] << 1) ^ ((uint8_t)(-carry) & 0x87);
+	}
+}
+
+
+static int xts_sharing(uint8_t **roundkeys1, uint8_t **roundkeys2, uint64_t first_sector, uint8_t * in, uint8_t * out,
+	size_t sector_size, size_t nb_sectors, int nb_threads, int decrypt){
+	
+	if(sector_size == 0 || sector_size % AES_BLOCK_SIZE != 0)
+		return -1;
+	
+	size_t sector_blocks = sector_size / AES_BLOCK_SIZE;
+	size_t chunk_sectors = nb_sectors < XTS_CHUNK_SECTORS ? nb_sectors : XTS_CHUNK_SECTORS;
+	uint8_t * tweaks = (uint8_t *)malloc(chunk_sectors * sector_blocks * AES_BLOCK_SHARING_SIZE);
+	uint8_t * first_tweaks = (uint8_t *)malloc(chunk_sectors * AES_BLOCK_SHARING_SIZE);
+	uint8_t sectors[XTS_CHUNK_SECTORS * AES_BLOCK_SIZE];
+	
+	for(size_t done = 0; done < nb_sectors; done += chunk_sectors){
+		size_t nb = nb_sectors - done < chunk_sectors ? nb_sectors - done : chunk_sectors;
+		size_t nb_blocks = nb * sector_blocks;
+		uint8_t * x_in = in + done * sector_blocks * AES_BLOCK_SHARING_SIZE;
+		uint8_t * x_out = out + done * sector_blocks * AES_BLOCK_SHARING_SIZE;
+		size_t s, j;
+		
+		// T = AES(roundkeys2, sector number), for all the sectors of the chunk
+		for(s = 0; s < nb; s++){
+			uint64_t sector = first_sector + done + s;
+			for(int i = 0; i < AES_BLOCK_SIZE; i++){
+				sectors[s * AES_BLOCK_SIZE + i] = i < 8 ? (uint8_t)(sector >> (8 * i)) : 0;
+			}
+		}
+		generate_n_sharing_buffer(sectors, first_tweaks, nb * AES_BLOCK_SIZE);
+		aes_encrypt_128_sharing_batch(roundkeys2, first_tweaks, first_tweaks, nb, nb_threads);
+		
+		// tweak schedule T * alpha^j of each sector
+		for(s = 0; s < nb; s++){
+			uint8_t * t = tweaks + s * sector_blocks * AES_BLOCK_SHARING_SIZE;
+			memcpy(t, first_tweaks + s * AES_BLOCK_SHARING_SIZE, AES_BLOCK_SHARING_SIZE);
+			for(j = 1; j < sector_blocks; j++){
+				memcpy(t + j * AES_BLOCK_SHARING_SIZE, t + (j - 1) * AES_BLOCK_SHARING_SIZE, AES_BLOCK_SHARING_SIZE);
+				xts_mult_alpha_sharing(t + j * AES_BLOCK_SHARING_SIZE);
+			}
+		}
+		
+		for(j = 0; j < nb_blocks; j++){
+			add_block_sharing(x_in + j * AES_BLOCK_SHARING_SIZE, tweaks + j * AES_BLOCK_SHARING_SIZE, x_out + j * AES_BLOCK_SHARING_SIZE);
+		}
+		if(decrypt)
+			aes_decrypt_128_sharing_batch(roundkeys1, x_out, x_out, nb_blocks, nb_threads);
+		else
+			aes_encrypt_128_sharing_batch(roundkeys1, x_out, x_out, nb_blocks, nb_threads);
+		for(j = 0; j < nb_blocks; j++){
+			add_block_sharing(x_out + j * AES_BLOCK_SHARING_SIZE, tweaks + j * AES_BLOCK_SHARING_SIZE, x_out + j * AES_BLOCK_SHARING_SIZE);
+		}
+	}
+	
+	free(first_tweaks);
+	free(tweaks);
+	return 0;
+}
+
+
+int aes_xts_encrypt_128_sharing(uint8_t **roundkeys1, uint8_t **roundkeys2, uint64_t first_sector, uint8_t * in, uint8_t * out,
+	size_t sector_size, size_t nb_sectors, int nb_threads){
+	return xts_sharing(roundkeys1, roundkeys2, first_sector, in, out, sector_size, nb_sectors, nb_threads, 0);
+}
+
+
+int aes_xts_decrypt_128_sharing(uint8_t **roundkeys1, uint8_t **roundkeys2, uint64_t first_sector, uint8_t * in, uint8_t * out,
+	size_t sector_size, size_t nb_sectors, int nb_threads){
+	return xts_sharing(roundkeys1, roundkeys2, first_sector, in, out, sector_size, nb_sectors, nb_threads, 1);
+}
@@ -0,0 +1,82 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#ifndef AES128_XTS_SHARING_H
+#define AES128_XTS_SHARING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes128_batch.h"
+
+/**********************************************************
+ * n-share AES-128-XTS (IEEE 1619) for sector oriented 
+ * encryption. The data is given as n-share block buffers
+ * (see aes128_batch.h) of nb_sectors sectors of 
+ * sector_size bytes, sector_size being a multiple of 
+ * AES_BLOCK_SIZE (ciphertext stealing is not supported).
+ * 
+ * For each sector, the tweak T = AES(roundkeys2, sector)
+ * is computed in the n-share domain and the tweak 
+ * schedule T * alpha^j is derived once for the whole
+ * sector. Since the multiplication by alpha is linear, it
+ * is applied share by share and does not need randomness.
+ * The sectors are processed XTS_CHUNK_SECTORS at a time,
+ * and all the blocks of a chunk are encrypted as one 
+ * batch over nb_threads threads.
+**********************************************************/
+
+#define XTS_CHUNK_SECTORS 16
+
+
+/**********************************************************
+ * roundkeys1 : n-share round keys of the data key
+ * roundkeys2 : n-share round keys of the tweak key
+ * first_sector : number of the first sector of in
+ * in : n-share block buffer of nb_sectors sectors
+ * out : n-share block buffer of nb_sectors sectors
+ * in and out may be the same buffer.
+ * Returns 0 on success, -1 if sector_size is not a non
+ * zero multiple of AES_BLOCK_SIZE
+**********************************************************/
+int aes_xts_encrypt_128_sharing(uint8_t **roundkeys1, uint8_t **roundkeys2, uint64_t first_sector, uint8_t * in, uint8_t * out,
+	size_t sector_size, size_t nb_sectors, int nb_threads);
+
+int aes_xts_decrypt_128_sharing(uint8_t **roundkeys1, uint8_t **roundkeys2, uint64_t first_sector, uint8_t * in, uint8_t * out,
+	size_t sector_size, size_t nb_sectors, int nb_threads);
+
+
+/**********************************************************
+ * t : n-share block
+ * Multiplies t by alpha in GF(2^128) (XTS convention,
+ * little endian), share by share
+**********************************************************/
+void xts_mult_alpha_sharing(uint8_t * t);
+
+#endif
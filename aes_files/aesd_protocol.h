@@ -0,0 +1,77 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#ifndef AESD_PROTOCOL_H
+#define AESD_PROTOCOL_H
+
+#include <stdint.h>
+
+/**********************************************************
+ * Protocol between aesd (the local n-share AES-128 
+ * daemon) and its clients, over a Unix domain stream 
+ * socket. Both ends run on the same host, so the fields
+ * are in host byte order.
+ * 
+ * A request is an aesd_request header followed by 
+ * nb_blocks * AES_BLOCK_SIZE bytes of data, the answer is
+ * an aesd_response header followed, when status is
+ * AESD_OK, by nb_blocks * AES_BLOCK_SIZE bytes of result.
+ * The data is masked with generate_n_sharing when it
+ * enters the daemon, and only unmasked with
+ * compress_n_sharing once processed.
+**********************************************************/
+
+#define AESD_DEFAULT_SOCKET "/tmp/aesd.sock"
+#define AESD_MAGIC          0x41455344
+#define AESD_MAX_BLOCKS     4096
+
+#define AESD_OP_ENCRYPT     1
+#define AESD_OP_DECRYPT     2
+
+#define AESD_OK             0
+#define AESD_ERR_REQUEST    -1
+#define AESD_ERR_KEY        -2
+
+typedef struct {
+	uint32_t magic;
+	uint32_t op;
+	uint32_t key_id;
+	uint32_t nb_blocks;
+	uint64_t tag;
+} aesd_request;
+
+typedef struct {
+	uint32_t magic;
+	int32_t status;
+	uint32_t nb_blocks;
+	uint32_t reserved;
+	uint64_t tag;
+} aesd_response;
+
+#endif
@@ -33,9 +33,32 @@
 
 ***************************************************************************/
 
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "gadgets.h"
 #include "gf256.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GADGETS_X86
+#include <immintrin.h>
+#endif
+
+/**********************************************************
+ * With at least 16 shares, mult_cons_gadget_function uses
+ * PSHUFB (SSSE3) or VPSHUFB (AVX2) when the CPU has them,
+ * whatever the compile flags (see mult_cons_shuffle)
+**********************************************************/
+#if NB_SHARES >= 16 && defined(GADGETS_X86)
+#define MULT_CONS_SHUFFLE
+#endif
+
 /**********************************************************
  * Creates a n-share randomized variable of
  *  the variable a, and stores it in the array a_sharing
@@ -67,87 +90,318 @@ uint8_t compress_n_sharing(uint8_t * a_sharing){
 }
 
 
+void get_rand_buffer(uint8_t * buf, size_t len){
+#ifdef RAND_RING
+	rand_ring_fill(buf, len);
+#else
+	// same values as get_rand(), with the counter kept in a 
+	// register (buf may alias it as far as the compiler knows)
+	uint8_t c = counter;
+	size_t i = 0;
+#ifdef __SSE2__
+	// 16 consecutive counter values at a time
+	const __m128i step = _mm_set_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	const __m128i ff = _mm_set1_epi8((char)0xff);
+	for(; i + 16 <= len; i += 16){
+		__m128i x = _mm_add_epi8(_mm_set1_epi8((char)c), step);
+		_mm_storeu_si128((__m128i *)(buf + i), _mm_xor_si128(x, ff));
+		c += 16;
+	}
+#endif
+	for(; i < len; i++){
+		buf[i] = c++ ^ 0xff;
+	}
+	counter = c;
+#endif
+}
+
 
 /**********************************************************
- * cons : constant value
- * a : n-share input variable
- * c : n-share output variable
- * Computes c = a + cons by creating a sharing of cons
- * as (cons, 0, ..., 0) and calling the addition gadget
+ * out[i] = xor of the NB_SHARES shares of in[i * NB_SHARES]
+ * 
+ * With at least 16 shares, the shares of each variable 
+ * are xored 16 at a time and the vector is then reduced.
+ * With less than 16 shares, 16 variables are exactly 
+ * NB_SHARES vectors: their prefix xor P is computed in 
+ * log steps, and out[j] = P[(j+1)n - 1] ^ P[jn - 1].
 **********************************************************/
-void add_cons_gadget_function(uint8_t cons, uint8_t * a, uint8_t * c){
+static void xor_shares(const uint8_t * in, uint8_t * out, size_t len){
+	size_t i = 0;
+	
+#ifdef __SSE2__
+#if NB_SHARES >= 16
+	for(; i < len; i++){
+		const uint8_t * p = in + i * NB_SHARES;
+		__m128i acc = _mm_loadu_si128((const __m128i *)p);
+		int s;
+		for(s = 16; s + 16 <= NB_SHARES; s += 16){
+			acc = _mm_xor_si128(acc, _mm_loadu_si128((const __m128i *)(p + s)));
+		}
+		acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 8));
+		acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 4));
+		acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 2));
+		acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 1));
+		uint8_t res = (uint8_t)_mm_cvtsi128_si32(acc);
+		for(; s < NB_SHARES; s++){
+			res ^= p[s];
+		}
+		out[i] = res;
+	}
+#else
+	uint8_t prefix[16 * NB_SHARES];
+	for(; i + 16 <= len; i += 16){
+		const uint8_t * p = in + i * NB_SHARES;
+		uint8_t carry = 0;
+		for(int v = 0; v < NB_SHARES; v++){
+			__m128i x = _mm_loadu_si128((const __m128i *)(p + 16 * v));
+			x = _mm_xor_si128(x, _mm_slli_si128(x, 1));
+			x = _mm_xor_si128(x, _mm_slli_si128(x, 2));
+			x = _mm_xor_si128(x, _mm_slli_si128(x, 4));
+			x = _mm_xor_si128(x, _mm_slli_si128(x, 8));
+			x = _mm_xor_si128(x, _mm_set1_epi8((char)carry));
+			_mm_storeu_si128((__m128i *)(prefix + 16 * v), x);
+			carry = prefix[16 * v + 15];
+		}
+		out[i] = prefix[NB_SHARES - 1];
+		for(int j = 1; j < 16; j++){
+			out[i + j] = prefix[(j + 1) * NB_SHARES - 1] ^ prefix[j * NB_SHARES - 1];
+		}
+	}
+#endif
+#endif
+	
+	for(; i < len; i++){
+		out[i] = compress_n_sharing((uint8_t *)in + i * NB_SHARES);
+	}
+}
+
 
-	const_s[0] = cons;
+/**********************************************************
+ * All the shares of a run of variables are first drawn 
+ * at random in one go, then the last share of each 
+ * variable is corrected so that the shares xor to in[i]
+ * (the runs are short enough to stay in L1)
+**********************************************************/
+void generate_n_sharing_buffer(const uint8_t * in, uint8_t * out, size_t len){
+	uint8_t sum[256];
+	
+	for(size_t i = 0; i < len; i += sizeof(sum)){
+		size_t n = len - i < sizeof(sum) ? len - i : sizeof(sum);
+		get_rand_buffer(out + i * NB_SHARES, n * NB_SHARES);
+		xor_shares(out + i * NB_SHARES, sum, n);
+		for(size_t j = 0; j < n; j++){
+			out[(i + j) * NB_SHARES + NB_SHARES - 1] ^= sum[j] ^ in[i + j];
+		}
+	}
+}
+
+
+void compress_n_sharing_buffer(const uint8_t * in, uint8_t * out, size_t len){
+	xor_shares(in, out, len);
+}
+
+
+/**********************************************************
+ * dst ^= src over len bytes, 16 bytes at a time with SSE2
+**********************************************************/
+static void xor_buffer(uint8_t * dst, const uint8_t * src, size_t len){
+	size_t i = 0;
 	
-	add_gadget_function(const_s, a, c);
+#ifdef __SSE2__
+	for(; i + 16 <= len; i += 16){
+		__m128i x = _mm_loadu_si128((const __m128i *)(dst + i));
+		x = _mm_xor_si128(x, _mm_loadu_si128((const __m128i *)(src + i)));
+		_mm_storeu_si128((__m128i *)(dst + i), x);
+	}
+#endif
 	
+	for(; i < len; i++){
+		dst[i] ^= src[i];
+	}
 }
 
 
+/**********************************************************
+ * The fresh sharings of 0 are built run by run as in 
+ * generate_n_sharing_buffer (random shares, the last one
+ * corrected so that they xor to 0), then the whole run is
+ * xored into buf
+**********************************************************/
+#define REFRESH_RUN (NB_SHARES < 4096 ? 4096 / NB_SHARES : 1)
+
+void refresh_n_sharing_buffer(uint8_t * buf, size_t len){
+	uint8_t zero[REFRESH_RUN * NB_SHARES];
+	uint8_t sum[REFRESH_RUN];
+	
+	for(size_t i = 0; i < len; i += REFRESH_RUN){
+		size_t n = len - i < REFRESH_RUN ? len - i : REFRESH_RUN;
+		get_rand_buffer(zero, n * NB_SHARES);
+		xor_shares(zero, sum, n);
+		for(size_t j = 0; j < n; j++){
+			zero[j * NB_SHARES + NB_SHARES - 1] ^= sum[j];
+		}
+		xor_buffer(buf + i * NB_SHARES, zero, n * NB_SHARES);
+	}
+}
+
+
+
+static _Thread_local uint8_t * scratch_base = NULL;
+static _Thread_local size_t scratch_top = 0;
+
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+static pthread_key_t scratch_key;
+
+static void scratch_make_key(void){
+	pthread_key_create(&scratch_key, free);
+}
+
+
+uint8_t * scratch_push(int nb_vars){
+	if(!scratch_base){
+		scratch_base = (uint8_t *)malloc((size_t)SCRATCH_VARS * NB_SHARES);
+		if(!scratch_base){
+			fprintf(stderr, "scratch: out of memory\n");
+			abort();
+		}
+		pthread_once(&scratch_once, scratch_make_key);
+		pthread_setspecific(scratch_key, scratch_base);
+	}
+	if(scratch_top + nb_vars > SCRATCH_VARS){
+		fprintf(stderr, "scratch: more than %d variables\n", SCRATCH_VARS);
+		abort();
+	}
+	
+	uint8_t * vars = scratch_base + scratch_top * NB_SHARES;
+	scratch_top += nb_vars;
+	return vars;
+}
+
+
+void scratch_pop(int nb_vars){
+	scratch_top -= nb_vars;
+}
+
+
+/**********************************************************
+ * With GADGETS_FAST_PATH (NB_SHARES = 2 or 3), the gadgets
+ * below are replaced by the inline ones of gadgets_base.h
+**********************************************************/
+#ifndef GADGETS_FAST_PATH
+
 /**********************************************************
  * cons : constant value
  * a : n-share input variable
  * c : n-share output variable
- * Computes c = a * cons by creating a sharing of cons
- * as (cons, 0, ..., 0) and calling the 
- * multiplicaction gadget
+ * Computes c = a + cons. The constant is public, so it is
+ * added to the first share only, without randomness
 **********************************************************/
-void mult_cons_gadget_function(uint8_t cons, uint8_t * a, uint8_t * c){
+void add_cons_gadget_function(uint8_t cons, uint8_t * a, uint8_t * c){
+	for(int i = 0; i < NB_SHARES; i++){
+		c[i] = a[i];
+	}
+	c[0] = Add(c[0], cons);
+}
+
+
+#ifdef MULT_CONS_SHUFFLE
+
+/**********************************************************
+ * Split nibble tables: cons * x = lo[x & 15] ^ hi[x >> 4]
+ * with lo[j] = cons * j and hi[j] = cons * (j << 4) = 
+ * (cons * 16) * j, which are the first 16 bytes of the 
+ * rows cons and cons * 16 of mult_table. PSHUFB looks up
+ * 16 shares at a time in these tables.
+ * Both return the number of shares done (the remaining 
+ * ones are done by the caller).
+**********************************************************/
+__attribute__((target("ssse3")))
+static int mult_cons_ssse3(uint8_t cons, uint8_t * a, uint8_t * c){
+	const __m128i lo = _mm_loadu_si128((const __m128i *)mult_table[cons]);
+	const __m128i hi = _mm_loadu_si128((const __m128i *)mult_table[mult_table[cons][16]]);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	int i;
 	
-	const_s[0] = cons;
+	for(i = 0; i + 16 <= NB_SHARES; i += 16){
+		__m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(x, mask));
+		__m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+		_mm_storeu_si128((__m128i *)(c + i), _mm_xor_si128(l, h));
+	}
+	return i;
+}
+
+
+__attribute__((target("avx2")))
+static int mult_cons_avx2(uint8_t cons, uint8_t * a, uint8_t * c){
+	const __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)mult_table[cons]));
+	const __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)mult_table[mult_table[cons][16]]));
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	int i;
 	
-	mult_gadget_function(a, const_s, c);
+	for(i = 0; i + 32 <= NB_SHARES; i += 32){
+		__m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(x, mask));
+		__m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi16(x, 4), mask));
+		_mm256_storeu_si256((__m256i *)(c + i), _mm256_xor_si256(l, h));
+	}
+	if(i + 16 <= NB_SHARES){
+		__m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i l = _mm_shuffle_epi8(_mm256_castsi256_si128(lo), _mm_and_si128(x, _mm256_castsi256_si128(mask)));
+		__m128i h = _mm_shuffle_epi8(_mm256_castsi256_si128(hi), _mm_and_si128(_mm_srli_epi16(x, 4), _mm256_castsi256_si128(mask)));
+		_mm_storeu_si128((__m128i *)(c + i), _mm_xor_si128(l, h));
+		i += 16;
+	}
+	return i;
 }
 
 
-void add_gadget_function_2(uint8_t * a, uint8_t * b, uint8_t * c){
-	uint8_t r0 = get_rand();
-	uint8_t r1 = get_rand();
-	uint8_t r2 = get_rand();
-	uint8_t r3 = get_rand();
-
-    uint8_t tmp = Add(r0,r2);
-	uint8_t var0 = Add(a[0], tmp) ;
-	tmp = Add(r1,r3);
-	uint8_t var1 = Add(b[0], tmp) ;
-	c[0] = Add(var0, var1) ;
-
-    tmp = Add(r1,r2);
-	var0 = Add(a[1], tmp) ;
-	tmp = Add(r0,r3);
-	var1 = Add(b[1], tmp) ;
-	c[1] = Add(var0, var1) ;
+/**********************************************************
+ * 2 for AVX2, 1 for SSSE3, 0 for neither (scalar), found 
+ * on the first call
+**********************************************************/
+static int mult_cons_isa = -1;
+
+static int mult_cons_shuffle(uint8_t cons, uint8_t * a, uint8_t * c){
+	int isa = mult_cons_isa;
+	
+	if(isa < 0){
+		isa = __builtin_cpu_supports("avx2") ? 2 : __builtin_cpu_supports("ssse3") ? 1 : 0;
+		mult_cons_isa = isa;
+	}
+	if(isa == 2)
+		return mult_cons_avx2(cons, a, c);
+	if(isa == 1)
+		return mult_cons_ssse3(cons, a, c);
+	return 0;
 }
 
-void add_gadget_function_3(uint8_t * a, uint8_t * b, uint8_t * c){
-	uint8_t r0 = get_rand();
-	uint8_t r1 = get_rand();
-	uint8_t r2 = get_rand();
-	uint8_t r3 = get_rand();
-	uint8_t r4 = get_rand();
-	uint8_t r5 = get_rand();
-
-	uint8_t var0 = Add(r0, r1) ;
-	uint8_t var1 = Add(a[0], var0) ;
-	uint8_t var2 = Add(r2, r3) ;
-	uint8_t var3 = Add(b[0], var2) ;
-	c[0] = Add(var1, var3) ;
-
-	uint8_t var4 = Add(r2, r4) ;
-	uint8_t var5 = Add(a[1], var4) ;
-	uint8_t var6 = Add(r5, r1) ;
-	uint8_t var7 = Add(b[1], var6) ;
-	c[1] = Add(var5, var7) ;
-
-	uint8_t var8 = Add(r5, r3) ;
-	uint8_t var9 = Add(a[2], var8) ;
-	uint8_t var10 = Add(r0, r4) ;
-	uint8_t var11 = Add(b[2], var10) ;
-	c[2] = Add(var9, var11) ;
+#endif
+
+
+/**********************************************************
+ * cons : constant value
+ * a : n-share input variable
+ * c : n-share output variable
+ * Computes c = a * cons. This is the multiplication 
+ * gadget with the sharing (cons, 0, ..., 0) of cons, 
+ * whose output share p is a_p * cons (its refresh values
+ * cancel out), so it is done share-wise without 
+ * randomness
+**********************************************************/
+void mult_cons_gadget_function(uint8_t cons, uint8_t * a, uint8_t * c){
+	int i = 0;
+	
+#ifdef MULT_CONS_SHUFFLE
+	i = mult_cons_shuffle(cons, a, c);
+#endif
+	for(; i < NB_SHARES; i++){
+		c[i] = Multiply(cons, a[i]);
+	}
 }
 
 
-void add_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c){
+void add_gadget_function_iterative(uint8_t * a, uint8_t * b, uint8_t * c){
     uint8_t m[3],n[3],k[3];
     int i = NB_SHARES/2;
     int r = NB_SHARES%2;
@@ -185,44 +439,7 @@ void add_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c){
 **********************************************************/
 
 
-void copy_gadget_function_2(uint8_t * a, uint8_t * d, uint8_t * e){
-	uint8_t r0 = get_rand();
-	uint8_t r1 = get_rand();
-
-	d[0] = Add(a[0], r0) ;
-	e[0] = Add(a[0], r1) ;
-
-	d[1] = Add(a[1], r0) ;
-	e[1] = Add(a[1], r1) ;
-}
-
-void copy_gadget_function_3(uint8_t * a, uint8_t * d, uint8_t * e){
-	uint8_t r0 = get_rand();
-	uint8_t r1 = get_rand();
-	uint8_t r2 = get_rand();
-	uint8_t r3 = get_rand();
-	uint8_t r4 = get_rand();
-	uint8_t r5 = get_rand();
-
-	uint8_t var0 = Add(r0, r1) ;
-	uint8_t var1 = Add(r1, r2) ;
-	uint8_t var2 = Add(r2, r0) ;
-	uint8_t var3 = Add(r3, r4) ;
-	uint8_t var4 = Add(r4, r5) ;
-	uint8_t var5 = Add(r5, r3) ;
-
-	d[0] = Add(a[0], var0) ;
-	e[0] = Add(a[0], var3) ;
-
-	d[1] = Add(a[1], var1) ;
-	e[1] = Add(a[1], var4) ;
-
-	d[2] = Add(a[2], var2) ;
-	e[2] = Add(a[2], var5) ;
-}
-
-
-void copy_gadget_function(uint8_t * a, uint8_t * d, uint8_t * e){
+void copy_gadget_function_iterative(uint8_t * a, uint8_t * d, uint8_t * e){
     uint8_t m[3],n[3],k[3];
     int i = NB_SHARES/2;
     int r = NB_SHARES%2;
@@ -258,85 +475,7 @@ void copy_gadget_function(uint8_t * a, uint8_t * d, uint8_t * e){
  * multiplicaction gadget
 **********************************************************/
 
-void mult_gadget_function_2(uint8_t * a, uint8_t * b, uint8_t * c){
-	uint8_t r0 = get_rand();
-	uint8_t r1 = get_rand();
-	uint8_t r2 = get_rand();
-	uint8_t r3 = get_rand();
-    
-    uint8_t u0 = Add(a[0],r0);
-    uint8_t u1 = Add(a[0],u0);
-    uint8_t v0 = Add(b[0],r1);
-    uint8_t v1 = Add(b[1],r1);
-    
-    uint8_t var0 = Multiply(u0, v0);
-	uint8_t var1 = Multiply(u0, v1) ;
-	uint8_t tmp1 = Add(var0,r2);
-	uint8_t tmp2 = Add(var1,r3);
-	c[0] = Add(tmp1, tmp2) ;
-
-	uint8_t var2 = Multiply(u1, v0) ;
-	uint8_t var3 = Multiply(u1, v1);
-	tmp1 = Add(var2, r2);
-	tmp2 = Add(var3,r3);
-    c[1] = Add(tmp1, tmp2);
-}
-
-void mult_gadget_function_3(uint8_t * a, uint8_t * b, uint8_t * c){
-	uint8_t r0 = get_rand();
-	uint8_t r1 = get_rand();
-	uint8_t r2 = get_rand();
-	uint8_t r3 = get_rand();
-	uint8_t r4 = get_rand();
-	uint8_t r5 = get_rand();
-	uint8_t r6 = get_rand();
-	uint8_t r7 = get_rand();
-	uint8_t r8 = get_rand();
-	uint8_t r9 = get_rand();
-
-    uint8_t tmp = Add(r0,r1);
-    uint8_t u0 = Add(a[0],tmp);
-    uint8_t u00 = Add(u0,a[0]);
-    tmp = Add(r3,r4);
-    uint8_t v0 = Add(b[0],tmp);
-
-	uint8_t var0 = Multiply(u0, v0) ;
-	uint8_t var1 = Multiply(u00, v0) ;
-	uint8_t var2 = Add(var0,r6);
-	uint8_t var3 = Add(var1,r7);
-	c[0] = Add(var2, var3) ;
-
-
-    tmp = Add(r1,r2);
-    uint8_t u1 = Add(a[1],tmp);
-    uint8_t u11 = Add(u1,a[1]);
-    tmp = Add(r4,r5);
-    uint8_t v1 = Add(b[1],tmp);
-
-	var0 = Multiply(u1, v1) ;
-	var1 = Multiply(u11, v1) ;
-	var2 = Add(var0,r8);
-	var3 = Add(var1,r9);
-	c[1] = Add(var2, var3) ;
-
-
-    tmp = Add(r2,r0);
-    uint8_t u2 = Add(a[2],tmp);
-    uint8_t u22 = Add(u2,a[2]);
-    tmp = Add(r5,r3);
-    uint8_t v2 = Add(b[2],tmp);
-
-	var0 = Multiply(u2, v2) ;
-	var1 = Multiply(u22, v2) ;
-	tmp = Add(r6,r8);
-	var2 = Add(var0,tmp);
-	tmp = Add(r7,r9);
-	var3 = Add(var1,tmp);
-	c[2] = Add(var2, var3) ;
-	
-}
-
-void mult_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c){
+void mult_gadget_function_scalar(uint8_t * a, uint8_t * b, uint8_t * c){
     uint8_t r0 = get_rand();
 	uint8_t r1 = get_rand();
 	
@@ -345,7 +484,7 @@ void mult_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c){
     int i = NB_SHARES/2;
     int r = NB_SHARES%2;
     for(int p = 0;p < NB_SHARES;p++){
-        c[p] = 0;
+        uint8_t acc = 0;    // c[p] is only written at the end, so c can be a
         for(int q = 0;q < i;q++){
             m[0] = a[p];
             m[1] = a[p];
@@ -354,31 +493,232 @@ void mult_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c){
             if(q != i - 1){
                 mult_gadget_function_2(m, n, k);
                 var[0] = Add(k[0],r0);
-                c[p] = Add(c[p],var[0]);
+                acc = Add(acc,var[0]);
                 var[1] = Add(k[1],r0);
-                c[p] = Add(c[p],var[1]);
+                acc = Add(acc,var[1]);
             }
             else if(r == 0){
                 mult_gadget_function_2(m, n, k);
                 var[0] = Add(k[0],r0);
-                c[p] = Add(c[p],var[0]);
+                acc = Add(acc,var[0]);
                 var[1] = Add(k[1],r0);
-                c[p] = Add(c[p],var[1]);
+                acc = Add(acc,var[1]);
             }
             else if(r == 1){
                 m[2] = a[p];
                 n[2] = b[q*2 + 2];
                 mult_gadget_function_3(m, n, k);
                 var[0] = Add(k[0],r0);
-                c[p] = Add(c[p],var[0]);
+                acc = Add(acc,var[0]);
                 var[1] = Add(k[1],r1);
-                c[p] = Add(c[p],var[1]);
+                acc = Add(acc,var[1]);
                 var[2] = Add(r0,r1);
                 var[2] = Add(k[2],var[2]);
-                c[p] = Add(c[p],var[2]);
+                acc = Add(acc,var[2]);
             }
         }
+        c[p] = acc;
     }
     
   return 0;
 }
+
+
+#ifdef GADGETS_X86
+
+/**********************************************************
+ * Vector version of the pair loop above: for each share p
+ * of a, the 2-share gadgets of all the pairs of shares of
+ * b are run side by side, 8 pairs (16 lanes) per vector.
+ * The lanes 2q and 2q + 1 hold the pair q, with
+ *   u0 = a_p + r0, u1 = a_p + u0 (both lanes of the pair)
+ *   v = b + r1
+ *   c = u0 * v + (r2, r3) and u1 * v + (r2, r3)
+ * as in mult_gadget_function_2, the r0, r1, r2, r3 of 8
+ * pairs being drawn at once, and the products computed
+ * by GF2P8MULB (GFNI, same field polynomial as AES). The
+ * lanes are then xored into c[p]. With an odd NB_SHARES,
+ * the last 3 shares of b go through 
+ * mult_gadget_function_3, as above.
+ * The output share p is thus a_p * (b_0 + ... + b_{n-1}),
+ * the same as with the scalar version.
+**********************************************************/
+#define MULT_PAIRS  (NB_SHARES % 2 ? NB_SHARES / 2 - 1 : NB_SHARES / 2)
+#define MULT_LANES  (2 * MULT_PAIRS)
+#define MULT_CHUNKS ((MULT_LANES + 15) / 16)
+
+__attribute__((target("gfni")))
+static void mult_rows_gfni(uint8_t * a, const uint8_t * bb, const uint8_t * last_lanes, uint8_t * res){
+	uint8_t rnd[32 * MULT_CHUNKS];
+	
+	for(int p = 0; p < NB_SHARES; p++){
+		const __m128i ap = _mm_set1_epi8((char)a[p]);
+		__m128i acc = _mm_setzero_si128();
+		get_rand_buffer(rnd, sizeof(rnd));
+		for(int k = 0; k < MULT_CHUNKS; k++){
+			__m128i ra = _mm_loadu_si128((const __m128i *)(rnd + 32 * k));
+			__m128i rb = _mm_loadu_si128((const __m128i *)(rnd + 32 * k + 16));
+			__m128i r0 = _mm_unpacklo_epi8(ra, ra);
+			__m128i r1 = _mm_unpackhi_epi8(ra, ra);
+			__m128i r23 = _mm_unpacklo_epi8(rb, _mm_srli_si128(rb, 8));
+			__m128i u0 = _mm_xor_si128(ap, r0);
+			__m128i u1 = _mm_xor_si128(ap, u0);
+			__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(bb + 16 * k)), r1);
+			__m128i t0 = _mm_xor_si128(_mm_gf2p8mul_epi8(u0, v), r23);
+			__m128i t1 = _mm_xor_si128(_mm_gf2p8mul_epi8(u1, v), r23);
+			__m128i t = _mm_xor_si128(t0, t1);
+			if(k == MULT_CHUNKS - 1)
+				t = _mm_and_si128(t, _mm_loadu_si128((const __m128i *)last_lanes));
+			acc = _mm_xor_si128(acc, t);
+		}
+		acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 8));
+		acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 4));
+		acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 2));
+		acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 1));
+		res[p] = (uint8_t)_mm_cvtsi128_si32(acc);
+	}
+}
+
+static int mult_gfni = -1;
+
+#endif
+
+
+void mult_gadget_function_simd(uint8_t * a, uint8_t * b, uint8_t * c){
+#ifdef GADGETS_X86
+	uint8_t bb[16 * MULT_CHUNKS] = { 0 };
+	uint8_t last_lanes[16] = { 0 };
+	uint8_t res[NB_SHARES];
+	int p, i;
+	
+	if(mult_gfni < 0)
+		mult_gfni = __builtin_cpu_supports("gfni") ? 1 : 0;
+	if(mult_gfni){
+		for(i = 0; i < MULT_LANES; i++){
+			bb[i] = b[i];
+		}
+		for(i = 0; i < MULT_LANES - 16 * (MULT_CHUNKS - 1); i++){
+			last_lanes[i] = 0xff;
+		}
+		mult_rows_gfni(a, bb, last_lanes, res);
+		
+#if NB_SHARES % 2
+		// last 3 shares of b (their refresh values cancel out in c[p], see gadgets_base.h)
+		uint8_t m[3], k[3];
+		for(p = 0; p < NB_SHARES; p++){
+			m[0] = m[1] = m[2] = a[p];
+			mult_gadget_function_3(m, b + NB_SHARES - 3, k);
+			res[p] ^= k[0] ^ k[1] ^ k[2];
+		}
+#endif
+		
+		for(p = 0; p < NB_SHARES; p++){
+			c[p] = res[p];
+		}
+		return;
+	}
+#endif
+	mult_gadget_function_scalar(a, b, c);
+}
+
+
+/**********************************************************
+ * The vector version is used from MULT_SIMD_MIN_SHARES 
+ * shares
+**********************************************************/
+void mult_gadget_function_iterative(uint8_t * a, uint8_t * b, uint8_t * c){
+#if NB_SHARES >= MULT_SIMD_MIN_SHARES
+	mult_gadget_function_simd(a, b, c);
+#else
+	mult_gadget_function_scalar(a, b, c);
+#endif
+}
+
+
+#ifdef EXPANSION_LEVEL
+
+void add_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c){
+	add_gadget_function_expand(a, b, c);
+}
+
+void copy_gadget_function(uint8_t * a, uint8_t * d, uint8_t * e){
+	copy_gadget_function_expand(a, d, e);
+}
+
+void mult_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c){
+	mult_gadget_function_expand(a, b, c);
+}
+
+#else
+
+void add_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c){
+	add_gadget_function_iterative(a, b, c);
+}
+
+void copy_gadget_function(uint8_t * a, uint8_t * d, uint8_t * e){
+	copy_gadget_function_iterative(a, d, e);
+}
+
+void mult_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c){
+	mult_gadget_function_iterative(a, b, c);
+}
+
+#endif
+
+#endif
+
+
+#if GADGETS_EXPANSION_LEVEL
+
+/**********************************************************
+ * Recursive gadgets of the expanding compiler, one level
+ * of gadgets_expand.h per power of 3 up to NB_SHARES, on
+ * top of the 1-share ones below
+**********************************************************/
+static void add_gadget_expand_1(uint8_t * a, uint8_t * b, uint8_t * c){
+	c[0] = Add(a[0], b[0]);
+}
+
+static void mult_gadget_expand_1(uint8_t * a, uint8_t * b, uint8_t * c){
+	c[0] = Multiply(a[0], b[0]);
+}
+
+#define EXP_SHARES 3
+#define EXP_SUB 1
+#define EXP_FN(f) f##_3
+#define EXP_SUB_FN(f) f##_1
+#include "gadgets_expand.h"
+
+#if GADGETS_EXPANSION_LEVEL >= 2
+#define EXP_SHARES 9
+#define EXP_SUB 3
+#define EXP_FN(f) f##_9
+#define EXP_SUB_FN(f) f##_3
+#include "gadgets_expand.h"
+#endif
+
+#if GADGETS_EXPANSION_LEVEL >= 3
+#define EXP_SHARES 27
+#define EXP_SUB 9
+#define EXP_FN(f) f##_27
+#define EXP_SUB_FN(f) f##_9
+#include "gadgets_expand.h"
+#endif
+
+#if GADGETS_EXPANSION_LEVEL >= 4
+#define EXP_SHARES 81
+#define EXP_SUB 27
+#define EXP_FN(f) f##_81
+#define EXP_SUB_FN(f) f##_27
+#include "gadgets_expand.h"
+#endif
+
+#if GADGETS_EXPANSION_LEVEL >= 5
+#define EXP_SHARES 243
+#define EXP_SUB 81
+#define EXP_FN(f) f##_243
+#define EXP_SUB_FN(f) f##_81
+#include "gadgets_expand.h"
+#endif
+
+#endif
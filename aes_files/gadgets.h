@@ -36,22 +36,80 @@
 #ifndef GADGETS_H
 #define GADGETS_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+/**********************************************************
+ * Can be set at compile time, e.g. 
+ * make FLAGS="-O2 -DNB_SHARES=256"
+ * 
+ * EXPANSION_LEVEL k (1 to 5) selects the recursive gadgets
+ * of the expanding compiler on 3^k shares instead of the
+ * iterative ones (see gadgets_expand.h), e.g.
+ * make FLAGS="-O2 -DEXPANSION_LEVEL=3"
+**********************************************************/
+#ifdef EXPANSION_LEVEL
+#if EXPANSION_LEVEL < 1 || EXPANSION_LEVEL > 5
+#error "EXPANSION_LEVEL must be between 1 and 5"
+#endif
+#ifndef NB_SHARES
+#define NB_SHARES (EXPANSION_LEVEL == 1 ? 3 : EXPANSION_LEVEL == 2 ? 9 : EXPANSION_LEVEL == 3 ? 27 : EXPANSION_LEVEL == 4 ? 81 : 243)
+#endif
+#endif
+
+#ifndef NB_SHARES
 #define NB_SHARES 5
+#endif
 
-static int test_num = 0;
+// k when NB_SHARES = 3^k, for which the recursive gadgets exist, 0 otherwise
+#if NB_SHARES == 3
+#define GADGETS_EXPANSION_LEVEL 1
+#elif NB_SHARES == 9
+#define GADGETS_EXPANSION_LEVEL 2
+#elif NB_SHARES == 27
+#define GADGETS_EXPANSION_LEVEL 3
+#elif NB_SHARES == 81
+#define GADGETS_EXPANSION_LEVEL 4
+#elif NB_SHARES == 243
+#define GADGETS_EXPANSION_LEVEL 5
+#else
+#define GADGETS_EXPANSION_LEVEL 0
+#endif
+
+#if defined(EXPANSION_LEVEL) && EXPANSION_LEVEL != GADGETS_EXPANSION_LEVEL
+#error "NB_SHARES must be 3^EXPANSION_LEVEL"
+#endif
+
+/**********************************************************
+ * With 2 or 3 shares, the gadgets are the inline ones of
+ * gadgets_base.h (see there)
+**********************************************************/
+#if !defined(NO_GADGETS_FAST_PATH) && !defined(EXPANSION_LEVEL) && (NB_SHARES == 2 || NB_SHARES == 3)
+#define GADGETS_FAST_PATH
+#endif
 
-static uint8_t const_s[NB_SHARES];
+static int test_num = 0;
 
 /**********************************************************
  * For the generation of random values,we  assume  
  * the  availability  of  an  efficient  (pseudo)random  
  * number  generator,  and  so  we  simply consider
  *  the values of an incremented counter variable to 
- * simulate the cost
+ * simulate the cost. The counter is thread local, so
+ * that several threads can run the gadgets concurrently
+ * (see aes128_batch.h)
+**********************************************************/
+static _Thread_local uint8_t counter = 0;
+
+/**********************************************************
+ * With -DRAND_RING the random values are instead read from
+ * a ring filled by a background producer thread (see
+ * rand_ring.h)
 **********************************************************/
-static uint8_t counter = 0;
+#ifdef RAND_RING
+#include "rand_ring.h"
+#define get_rand() rand_ring_get()
+#endif
 #ifndef get_rand()
 #define get_rand() counter++ ^ 0xff
 #endif
@@ -71,12 +129,69 @@ void generate_n_sharing(uint8_t a, uint8_t * a_sharing);
 uint8_t compress_n_sharing(uint8_t * a_sharing);
 
 
+/**********************************************************
+ * Fills buf with len random bytes (bulk get_rand)
+**********************************************************/
+void get_rand_buffer(uint8_t * buf, size_t len);
+
+
+/**********************************************************
+ * Bulk versions of generate_n_sharing and 
+ * compress_n_sharing, for a buffer of len bytes and its
+ * n-share version (the NB_SHARES shares of in[i] are at
+ * out[i * NB_SHARES], as in aes128_batch.h).
+ * The shares are xored with SSE2 when available.
+ * For generate, in and out must not overlap; compress
+ * can be done in place (out = in).
+**********************************************************/
+void generate_n_sharing_buffer(const uint8_t * in, uint8_t * out, size_t len);
+void compress_n_sharing_buffer(const uint8_t * in, uint8_t * out, size_t len);
+
+
+/**********************************************************
+ * Re-randomizes in place the len n-share variables of buf
+ * (same layout as above): a fresh sharing of 0 is xored
+ * into the shares of each variable, so that the values
+ * are unchanged. This is the bulk version of refreshing
+ * every variable with copy_gadget_function.
+**********************************************************/
+void refresh_n_sharing_buffer(uint8_t * buf, size_t len);
+
+
+/**********************************************************
+ * Thread local arena of SCRATCH_VARS n-share variables, 
+ * for the temporaries of the S-boxes and of MixColumns.
+ * It is allocated once per thread, on the first push, and
+ * freed when the thread exits, so that the memory used by
+ * the cipher grows linearly with NB_SHARES and does not 
+ * depend on the stack size of the threads.
+ * scratch_push returns nb_vars consecutive variables 
+ * (nb_vars * NB_SHARES bytes), given back in reverse 
+ * order with scratch_pop. The tables of the table 
+ * recomputation S-box are not in the arena: they have 
+ * their own thread local buffer, only allocated by the 
+ * threads that use that S-box (sbox_table_sharing.c).
+**********************************************************/
+#define SCRATCH_VARS 128
+
+uint8_t * scratch_push(int nb_vars);
+
+void scratch_pop(int nb_vars);
+
+
+// number of shares from which mult_gadget_function is vectorized (see below)
+#ifndef MULT_SIMD_MIN_SHARES
+#define MULT_SIMD_MIN_SHARES 16
+#endif
+
+#ifndef GADGETS_FAST_PATH
+
 /**********************************************************
  * cons : constant value
  * a : n-share input variable
  * c : n-share output variable
- * Computes c = a + cons by creating a sharing of cons
- * as (cons, 0, ..., 0) and calling the addition gadget
+ * Computes c = a + cons by adding the public constant
+ * to the first share, without randomness (c can be a)
 **********************************************************/
 void add_cons_gadget_function(uint8_t cons, uint8_t * a, uint8_t * c);
 
@@ -85,9 +200,10 @@ void add_cons_gadget_function(uint8_t cons, uint8_t * a, uint8_t * c);
  * cons : constant value
  * a : n-share input variable
  * c : n-share output variable
- * Computes c = a * cons by creating a sharing of cons
- * as (cons, 0, ..., 0) and calling the 
- * multiplicaction gadget
+ * Computes c = a * cons, share by share (the result of
+ * the multiplication gadget with the sharing 
+ * (cons, 0, ..., 0) of cons), with PSHUFB/VPSHUFB when 
+ * available (c can be a)
 **********************************************************/
 void mult_cons_gadget_function(uint8_t cons, uint8_t * a, uint8_t * c);
 
@@ -97,6 +213,7 @@ void mult_cons_gadget_function(uint8_t cons, uint8_t * a, uint8_t * c);
  * b : n-share input variable
  * c : n-share output variable
  * n-share addition gadget that computes c = a + b
+ * (c can be a or b)
 **********************************************************/
 void add_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c);
 
@@ -106,7 +223,7 @@ void add_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c);
  * d : n-share output variable
  * e : n-share output variable
  * n-share copy gadgets that creates d and e, fresh copies 
- * of a
+ * of a (d or e can be a)
 **********************************************************/
 void copy_gadget_function(uint8_t * a, uint8_t * d, uint8_t * e);
 
@@ -116,10 +233,58 @@ void copy_gadget_function(uint8_t * a, uint8_t * d, uint8_t * e);
  * b : n-share input variable
  * c : n-share output variable
  * n-share multiplication gadget that computes c = a * b
+ * (c can be a, but not b)
 **********************************************************/
 void mult_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c);
 
 
+/**********************************************************
+ * The two implementations of mult_gadget_function, with
+ * the same output: the scalar one runs the 2-share 
+ * gadgets of gadgets_base.h pair by pair, the vector one
+ * runs 8 of them per vector, with the products of GF(256)
+ * computed by GF2P8MULB. The vector one falls back to the
+ * scalar one when the CPU has no GFNI (a bit-serial SSE2
+ * product is slower than the table lookups).
+ * mult_gadget_function uses the vector one from 
+ * MULT_SIMD_MIN_SHARES shares (see above)
+**********************************************************/
+void mult_gadget_function_scalar(uint8_t * a, uint8_t * b, uint8_t * c);
+
+void mult_gadget_function_simd(uint8_t * a, uint8_t * b, uint8_t * c);
+
+
+/**********************************************************
+ * The gadgets built by chaining 2-share and 3-share 
+ * gadgets pair by pair, used unless EXPANSION_LEVEL is set
+**********************************************************/
+void add_gadget_function_iterative(uint8_t * a, uint8_t * b, uint8_t * c);
+
+void copy_gadget_function_iterative(uint8_t * a, uint8_t * d, uint8_t * e);
+
+void mult_gadget_function_iterative(uint8_t * a, uint8_t * b, uint8_t * c);
+
+#endif
+
+
+#if GADGETS_EXPANSION_LEVEL
+/**********************************************************
+ * The gadgets of the expanding compiler on 3^k shares
+ * (k = GADGETS_EXPANSION_LEVEL), with the same interface
+ * as the ones above, c, d or e can be a or b (see 
+ * gadgets_expand.h). They are used by the ones above when
+ * EXPANSION_LEVEL is set.
+**********************************************************/
+void add_gadget_function_expand(uint8_t * a, uint8_t * b, uint8_t * c);
+
+void copy_gadget_function_expand(uint8_t * a, uint8_t * d, uint8_t * e);
+
+void mult_gadget_function_expand(uint8_t * a, uint8_t * b, uint8_t * c);
+#endif
+
+#include "gadgets_base.h"
+
+
 
 
 #endif
@@ -0,0 +1,298 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#ifndef GADGETS_BASE_H
+#define GADGETS_BASE_H
+
+#include "gadgets.h"
+#include "gf256.h"
+
+/**********************************************************
+ * Base 2-share and 3-share gadgets, from which the n-share
+ * gadgets of gadgets.c are built (the multiplication ones
+ * are called with a = (a_p, a_p) or (a_p, a_p, a_p), see
+ * mult_gadget_function).
+ * 
+ * They are inline so that, with NB_SHARES = 2 or 3, the
+ * whole cipher is compiled down to direct sequences of 
+ * them (GADGETS_FAST_PATH below, disabled with
+ * -DNO_GADGETS_FAST_PATH).
+**********************************************************/
+
+#define GADGET_INLINE static inline
+
+GADGET_INLINE void add_gadget_function_2(uint8_t * a, uint8_t * b, uint8_t * c){
+	uint8_t r0 = get_rand();
+	uint8_t r1 = get_rand();
+	uint8_t r2 = get_rand();
+	uint8_t r3 = get_rand();
+
+    uint8_t tmp = Add(r0,r2);
+	uint8_t var0 = Add(a[0], tmp) ;
+	tmp = Add(r1,r3);
+	uint8_t var1 = Add(b[0], tmp) ;
+	c[0] = Add(var0, var1) ;
+
+    tmp = Add(r1,r2);
+	var0 = Add(a[1], tmp) ;
+	tmp = Add(r0,r3);
+	var1 = Add(b[1], tmp) ;
+	c[1] = Add(var0, var1) ;
+}
+
+GADGET_INLINE void add_gadget_function_3(uint8_t * a, uint8_t * b, uint8_t * c){
+	uint8_t r0 = get_rand();
+	uint8_t r1 = get_rand();
+	uint8_t r2 = get_rand();
+	uint8_t r3 = get_rand();
+	uint8_t r4 = get_rand();
+	uint8_t r5 = get_rand();
+
+	uint8_t var0 = Add(r0, r1) ;
+	uint8_t var1 = Add(a[0], var0) ;
+	uint8_t var2 = Add(r2, r3) ;
+	uint8_t var3 = Add(b[0], var2) ;
+	c[0] = Add(var1, var3) ;
+
+	uint8_t var4 = Add(r2, r4) ;
+	uint8_t var5 = Add(a[1], var4) ;
+	uint8_t var6 = Add(r5, r1) ;
+	uint8_t var7 = Add(b[1], var6) ;
+	c[1] = Add(var5, var7) ;
+
+	uint8_t var8 = Add(r5, r3) ;
+	uint8_t var9 = Add(a[2], var8) ;
+	uint8_t var10 = Add(r0, r4) ;
+	uint8_t var11 = Add(b[2], var10) ;
+	c[2] = Add(var9, var11) ;
+}
+
+
+GADGET_INLINE void copy_gadget_function_2(uint8_t * a, uint8_t * d, uint8_t * e){
+	uint8_t r0 = get_rand();
+	uint8_t r1 = get_rand();
+
+	d[0] = Add(a[0], r0) ;
+	e[0] = Add(a[0], r1) ;
+
+	d[1] = Add(a[1], r0) ;
+	e[1] = Add(a[1], r1) ;
+}
+
+GADGET_INLINE void copy_gadget_function_3(uint8_t * a, uint8_t * d, uint8_t * e){
+	uint8_t r0 = get_rand();
+	uint8_t r1 = get_rand();
+	uint8_t r2 = get_rand();
+	uint8_t r3 = get_rand();
+	uint8_t r4 = get_rand();
+	uint8_t r5 = get_rand();
+
+	uint8_t var0 = Add(r0, r1) ;
+	uint8_t var1 = Add(r1, r2) ;
+	uint8_t var2 = Add(r2, r0) ;
+	uint8_t var3 = Add(r3, r4) ;
+	uint8_t var4 = Add(r4, r5) ;
+	uint8_t var5 = Add(r5, r3) ;
+
+	d[0] = Add(a[0], var0) ;
+	e[0] = Add(a[0], var3) ;
+
+	d[1] = Add(a[1], var1) ;
+	e[1] = Add(a[1], var4) ;
+
+	d[2] = Add(a[2], var2) ;
+	e[2] = Add(a[2], var5) ;
+}
+
+
+GADGET_INLINE void mult_gadget_function_2(uint8_t * a, uint8_t * b, uint8_t * c){
+	uint8_t r0 = get_rand();
+	uint8_t r1 = get_rand();
+	uint8_t r2 = get_rand();
+	uint8_t r3 = get_rand();
+    
+    uint8_t u0 = Add(a[0],r0);
+    uint8_t u1 = Add(a[0],u0);
+    uint8_t v0 = Add(b[0],r1);
+    uint8_t v1 = Add(b[1],r1);
+    
+    uint8_t var0 = Multiply(u0, v0);
+	uint8_t var1 = Multiply(u0, v1) ;
+	uint8_t tmp1 = Add(var0,r2);
+	uint8_t tmp2 = Add(var1,r3);
+	c[0] = Add(tmp1, tmp2) ;
+
+	uint8_t var2 = Multiply(u1, v0) ;
+	uint8_t var3 = Multiply(u1, v1);
+	tmp1 = Add(var2, r2);
+	tmp2 = Add(var3,r3);
+    c[1] = Add(tmp1, tmp2);
+}
+
+GADGET_INLINE void mult_gadget_function_3(uint8_t * a, uint8_t * b, uint8_t * c){
+	uint8_t r0 = get_rand();
+	uint8_t r1 = get_rand();
+	uint8_t r2 = get_rand();
+	uint8_t r3 = get_rand();
+	uint8_t r4 = get_rand();
+	uint8_t r5 = get_rand();
+	uint8_t r6 = get_rand();
+	uint8_t r7 = get_rand();
+	uint8_t r8 = get_rand();
+	uint8_t r9 = get_rand();
+
+    uint8_t tmp = Add(r0,r1);
+    uint8_t u0 = Add(a[0],tmp);
+    uint8_t u00 = Add(u0,a[0]);
+    tmp = Add(r3,r4);
+    uint8_t v0 = Add(b[0],tmp);
+
+	uint8_t var0 = Multiply(u0, v0) ;
+	uint8_t var1 = Multiply(u00, v0) ;
+	uint8_t var2 = Add(var0,r6);
+	uint8_t var3 = Add(var1,r7);
+	c[0] = Add(var2, var3) ;
+
+
+    tmp = Add(r1,r2);
+    uint8_t u1 = Add(a[1],tmp);
+    uint8_t u11 = Add(u1,a[1]);
+    tmp = Add(r4,r5);
+    uint8_t v1 = Add(b[1],tmp);
+
+	var0 = Multiply(u1, v1) ;
+	var1 = Multiply(u11, v1) ;
+	var2 = Add(var0,r8);
+	var3 = Add(var1,r9);
+	c[1] = Add(var2, var3) ;
+
+
+    tmp = Add(r2,r0);
+    uint8_t u2 = Add(a[2],tmp);
+    uint8_t u22 = Add(u2,a[2]);
+    tmp = Add(r5,r3);
+    uint8_t v2 = Add(b[2],tmp);
+
+	var0 = Multiply(u2, v2) ;
+	var1 = Multiply(u22, v2) ;
+	tmp = Add(r6,r8);
+	var2 = Add(var0,tmp);
+	tmp = Add(r7,r9);
+	var3 = Add(var1,tmp);
+	c[2] = Add(var2, var3) ;
+	
+}
+
+
+#ifdef GADGETS_FAST_PATH
+
+#if NB_SHARES == 2
+#define add_gadget_function_base  add_gadget_function_2
+#define copy_gadget_function_base copy_gadget_function_2
+#define mult_gadget_function_base mult_gadget_function_2
+#else
+#define add_gadget_function_base  add_gadget_function_3
+#define copy_gadget_function_base copy_gadget_function_3
+#define mult_gadget_function_base mult_gadget_function_3
+#endif
+
+/**********************************************************
+ * Same gadgets as the generic ones of gadgets.c for 
+ * NB_SHARES = 2 or 3, without the pair loops. The inputs
+ * are read before any output is written, so the outputs
+ * can be the inputs.
+**********************************************************/
+GADGET_INLINE void add_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c){
+	uint8_t m[NB_SHARES], n[NB_SHARES];
+	for(int i = 0; i < NB_SHARES; i++){
+		m[i] = a[i];
+		n[i] = b[i];
+	}
+	add_gadget_function_base(m, n, c);
+}
+
+
+GADGET_INLINE void copy_gadget_function(uint8_t * a, uint8_t * d, uint8_t * e){
+	uint8_t m[NB_SHARES];
+	for(int i = 0; i < NB_SHARES; i++){
+		m[i] = a[i];
+	}
+	copy_gadget_function_base(m, d, e);
+}
+
+
+/**********************************************************
+ * As in the generic version, c[p] is the sum of the 
+ * outputs of the base gadget on (a_p, ..., a_p) and b.
+ * The generic version also adds the refresh values r0 
+ * and r1 to these outputs, but they cancel out in the 
+ * sum, so they are not drawn here.
+**********************************************************/
+GADGET_INLINE void mult_gadget_function(uint8_t * a, uint8_t * b, uint8_t * c){
+	uint8_t m[NB_SHARES], n[NB_SHARES], k[NB_SHARES], res[NB_SHARES];
+	int p, i;
+	for(i = 0; i < NB_SHARES; i++){
+		n[i] = b[i];
+	}
+	for(p = 0; p < NB_SHARES; p++){
+		for(i = 0; i < NB_SHARES; i++){
+			m[i] = a[p];
+		}
+		mult_gadget_function_base(m, n, k);
+		res[p] = k[0];
+		for(i = 1; i < NB_SHARES; i++){
+			res[p] = Add(res[p], k[i]);
+		}
+	}
+	for(p = 0; p < NB_SHARES; p++){
+		c[p] = res[p];
+	}
+}
+
+
+/**********************************************************
+ * Share-wise, as in gadgets.c
+**********************************************************/
+GADGET_INLINE void add_cons_gadget_function(uint8_t cons, uint8_t * a, uint8_t * c){
+	for(int i = 0; i < NB_SHARES; i++){
+		c[i] = a[i];
+	}
+	c[0] = Add(c[0], cons);
+}
+
+
+GADGET_INLINE void mult_cons_gadget_function(uint8_t cons, uint8_t * a, uint8_t * c){
+	for(int i = 0; i < NB_SHARES; i++){
+		c[i] = Multiply(cons, a[i]);
+	}
+}
+
+#endif
+
+#endif
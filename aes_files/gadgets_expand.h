@@ -0,0 +1,147 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+
+/**********************************************************
+ * Gadgets of the expanding compiler on EXP_SHARES = 3^k
+ * shares, built from the ones on EXP_SUB = 3^(k-1) shares.
+ * 
+ * This file is a template, included by gadgets.c once per
+ * level with
+ *   EXP_SHARES, EXP_SUB : the numbers of shares
+ *   EXP_FN(f) : the name of f on EXP_SHARES shares
+ *   EXP_SUB_FN(f) : the name of f on EXP_SUB shares
+ * so that each level is compiled with constant sizes.
+ * 
+ * A variable on EXP_SHARES shares is seen as 3 blocks of 
+ * EXP_SUB shares (the 3 shares of the base gadget), and 
+ * each wire of the base 3-share gadget is replaced by a 
+ * block: an addition by the addition gadget of the level 
+ * below, a multiplication by its multiplication gadget, 
+ * and a random value by a block of random shares. The 
+ * base level (EXP_SUB = 1) is the one of Add, Multiply 
+ * and get_rand.
+ * 
+ * The wires with a fan-out (the blocks of the refreshed
+ * inputs of the multiplication) are reused as they are,
+ * without copy gadget, as in the iterative gadgets.
+**********************************************************/
+
+#define EXP_BLOCK(x, i) ((x) + (i) * EXP_SUB)
+
+
+/**********************************************************
+ * c_i = (a_i + r + r') + (b_i + r'' + r'''), with the 
+ * random blocks of add_gadget_function_3
+**********************************************************/
+static void EXP_FN(add_gadget_expand)(uint8_t * a, uint8_t * b, uint8_t * c){
+	static const uint8_t ra[3][2] = { { 0, 1 }, { 2, 4 }, { 5, 3 } };
+	static const uint8_t rb[3][2] = { { 2, 3 }, { 5, 1 }, { 0, 4 } };
+	uint8_t r[6 * EXP_SUB], s[EXP_SUB], t[EXP_SUB];
+	
+	get_rand_buffer(r, sizeof(r));
+	for(int i = 0; i < 3; i++){
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(r, ra[i][0]), EXP_BLOCK(r, ra[i][1]), s);
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(a, i), s, s);
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(r, rb[i][0]), EXP_BLOCK(r, rb[i][1]), t);
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(b, i), t, t);
+		EXP_SUB_FN(add_gadget_expand)(s, t, EXP_BLOCK(c, i));
+	}
+}
+
+
+/**********************************************************
+ * d_i = a_i + r_i + r_{i+1}, e_i = a_i + r_{3+i} + r_{3+i+1}
+ * as in copy_gadget_function_3
+**********************************************************/
+static void EXP_FN(copy_gadget_expand)(uint8_t * a, uint8_t * d, uint8_t * e){
+	uint8_t r[6 * EXP_SUB], s[EXP_SUB], t[EXP_SUB];
+	
+	get_rand_buffer(r, sizeof(r));
+	for(int i = 0; i < 3; i++){
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(r, i), EXP_BLOCK(r, (i + 1) % 3), s);
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(r, 3 + i), EXP_BLOCK(r, 3 + (i + 1) % 3), t);
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(a, i), s, s);
+		// d_i is written last, so that d and e can be a
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(a, i), t, EXP_BLOCK(e, i));
+		memcpy(EXP_BLOCK(d, i), s, EXP_SUB);
+	}
+}
+
+
+/**********************************************************
+ * The 3-share multiplication gadget: the inputs are 
+ * refreshed as in the copy gadget (x_i = a_i + r_i + 
+ * r_{i+1}, y_i = b_i + ...), the 9 products x_i * y_j are
+ * computed by the multiplication gadget of the level 
+ * below and compressed into 
+ *   c_i = x_i * y_0 + x_i * y_1 + x_i * y_2 + r + r'
+ * where the random blocks r + r' sum to zero over i.
+**********************************************************/
+static void EXP_FN(mult_gadget_expand)(uint8_t * a, uint8_t * b, uint8_t * c){
+	uint8_t r[9 * EXP_SUB], x[3 * EXP_SUB], y[3 * EXP_SUB], acc[3 * EXP_SUB], s[EXP_SUB];
+	int i, j;
+	
+	get_rand_buffer(r, sizeof(r));
+	for(i = 0; i < 3; i++){
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(r, i), EXP_BLOCK(r, (i + 1) % 3), s);
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(a, i), s, EXP_BLOCK(x, i));
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(r, 3 + i), EXP_BLOCK(r, 3 + (i + 1) % 3), s);
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(b, i), s, EXP_BLOCK(y, i));
+		EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(r, 6 + i), EXP_BLOCK(r, 6 + (i + 1) % 3), EXP_BLOCK(acc, i));
+	}
+	for(i = 0; i < 3; i++){
+		for(j = 0; j < 3; j++){
+			EXP_SUB_FN(mult_gadget_expand)(EXP_BLOCK(x, i), EXP_BLOCK(y, j), s);
+			EXP_SUB_FN(add_gadget_expand)(EXP_BLOCK(acc, i), s, EXP_BLOCK(acc, i));
+		}
+	}
+	memcpy(c, acc, sizeof(acc));
+}
+
+
+#if EXP_SHARES == NB_SHARES
+void add_gadget_function_expand(uint8_t * a, uint8_t * b, uint8_t * c){
+	EXP_FN(add_gadget_expand)(a, b, c);
+}
+
+void copy_gadget_function_expand(uint8_t * a, uint8_t * d, uint8_t * e){
+	EXP_FN(copy_gadget_expand)(a, d, e);
+}
+
+void mult_gadget_function_expand(uint8_t * a, uint8_t * b, uint8_t * c){
+	EXP_FN(mult_gadget_expand)(a, b, c);
+}
+#endif
+
+#undef EXP_BLOCK
+#undef EXP_SHARES
+#undef EXP_SUB
+#undef EXP_FN
+#undef EXP_SUB_FN
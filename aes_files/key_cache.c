@@ -0,0 +1,257 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "key_cache.h"
+#include "aes128.h"
+#include "gadgets.h"
+
+
+typedef struct key_cache_entry {
+	uint8_t * roundkeys[AES_ROUND_KEY_SIZE];    // must stay the first field
+	uint64_t handle;
+	int refcount;
+	struct key_cache_entry * hash_next;
+	struct key_cache_entry * lru_prev;          // towards the most recently used
+	struct key_cache_entry * lru_next;          // towards the least recently used
+	uint8_t shares[AES_ROUND_KEY_SIZE * NB_SHARES];
+} key_cache_entry;
+
+struct key_cache {
+	pthread_mutex_t lock;
+	key_cache_loader loader;
+	void * ctx;
+	key_cache_entry ** buckets;
+	size_t nb_buckets;
+	size_t max_entries;
+	size_t max_bytes;
+	size_t nb_entries;
+	key_cache_entry * lru_head;
+	key_cache_entry * lru_tail;
+	uint64_t hits, misses, evictions;
+};
+
+
+size_t key_cache_entry_size(void){
+	return sizeof(key_cache_entry);
+}
+
+
+static size_t bucket_of(key_cache * cache, uint64_t handle){
+	handle ^= handle >> 33;
+	handle *= 0xff51afd7ed558ccdULL;
+	handle ^= handle >> 33;
+	return handle & (cache->nb_buckets - 1);
+}
+
+
+static void lru_unlink(key_cache * cache, key_cache_entry * e){
+	if(e->lru_prev)
+		e->lru_prev->lru_next = e->lru_next;
+	else
+		cache->lru_head = e->lru_next;
+	if(e->lru_next)
+		e->lru_next->lru_prev = e->lru_prev;
+	else
+		cache->lru_tail = e->lru_prev;
+	e->lru_prev = e->lru_next = NULL;
+}
+
+
+static void lru_push_front(key_cache * cache, key_cache_entry * e){
+	e->lru_prev = NULL;
+	e->lru_next = cache->lru_head;
+	if(cache->lru_head)
+		cache->lru_head->lru_prev = e;
+	cache->lru_head = e;
+	if(!cache->lru_tail)
+		cache->lru_tail = e;
+}
+
+
+static key_cache_entry * lookup(key_cache * cache, uint64_t handle){
+	key_cache_entry * e = cache->buckets[bucket_of(cache, handle)];
+	while(e && e->handle != handle){
+		e = e->hash_next;
+	}
+	return e;
+}
+
+
+static void remove_entry(key_cache * cache, key_cache_entry * e){
+	key_cache_entry ** p = &cache->buckets[bucket_of(cache, e->handle)];
+	while(*p != e){
+		p = &(*p)->hash_next;
+	}
+	*p = e->hash_next;
+	lru_unlink(cache, e);
+	cache->nb_entries--;
+	memset(e->shares, 0, sizeof(e->shares));
+	free(e);
+}
+
+
+/**********************************************************
+ * Evicts least recently used unpinned entries until there
+ * is room for one more entry
+**********************************************************/
+static void make_room(key_cache * cache){
+	key_cache_entry * e = cache->lru_tail;
+	while(cache->nb_entries >= cache->max_entries && e){
+		key_cache_entry * prev = e->lru_prev;
+		if(e->refcount == 0){
+			remove_entry(cache, e);
+			cache->evictions++;
+		}
+		e = prev;
+	}
+}
+
+
+key_cache * key_cache_new(size_t max_bytes, key_cache_loader loader, void * ctx){
+	key_cache * cache = (key_cache *)calloc(1, sizeof(key_cache));
+	if(!cache)
+		return NULL;
+	
+	pthread_mutex_init(&cache->lock, NULL);
+	cache->loader = loader;
+	cache->ctx = ctx;
+	cache->max_bytes = max_bytes;
+	cache->max_entries = max_bytes / sizeof(key_cache_entry);
+	if(cache->max_entries == 0)
+		cache->max_entries = 1;
+	
+	cache->nb_buckets = 16;
+	while(cache->nb_buckets < cache->max_entries && cache->nb_buckets < ((size_t)1 << 24)){
+		cache->nb_buckets <<= 1;
+	}
+	cache->buckets = (key_cache_entry **)calloc(cache->nb_buckets, sizeof(key_cache_entry *));
+	if(!cache->buckets){
+		free(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+
+void key_cache_free(key_cache * cache){
+	while(cache->lru_head){
+		remove_entry(cache, cache->lru_head);
+	}
+	pthread_mutex_destroy(&cache->lock);
+	free(cache->buckets);
+	free(cache);
+}
+
+
+uint8_t ** key_cache_acquire(key_cache * cache, uint64_t handle){
+	key_cache_entry * e;
+	
+	pthread_mutex_lock(&cache->lock);
+	e = lookup(cache, handle);
+	if(e){
+		cache->hits++;
+		e->refcount++;
+		lru_unlink(cache, e);
+		lru_push_front(cache, e);
+		pthread_mutex_unlock(&cache->lock);
+		return e->roundkeys;
+	}
+	cache->misses++;
+	pthread_mutex_unlock(&cache->lock);
+	
+	// load, expand and share the key without holding the lock
+	uint8_t key[AES_BLOCK_SIZE], roundkeys[AES_ROUND_KEY_SIZE];
+	if(cache->loader(cache->ctx, handle, key) != 0)
+		return NULL;
+	e = (key_cache_entry *)malloc(sizeof(key_cache_entry));
+	if(!e)
+		return NULL;
+	aes_key_expansion_128(key, roundkeys);
+	for(int i = 0; i < AES_ROUND_KEY_SIZE; i++){
+		e->roundkeys[i] = e->shares + i * NB_SHARES;
+	}
+	generate_n_sharing_buffer(roundkeys, e->shares, AES_ROUND_KEY_SIZE);
+	memset(key, 0, sizeof(key));
+	memset(roundkeys, 0, sizeof(roundkeys));
+	e->handle = handle;
+	e->refcount = 1;
+	
+	pthread_mutex_lock(&cache->lock);
+	key_cache_entry * other = lookup(cache, handle);
+	if(other){
+		// another thread loaded the same handle in the meantime
+		other->refcount++;
+		lru_unlink(cache, other);
+		lru_push_front(cache, other);
+		pthread_mutex_unlock(&cache->lock);
+		memset(e->shares, 0, sizeof(e->shares));
+		free(e);
+		return other->roundkeys;
+	}
+	make_room(cache);
+	size_t b = bucket_of(cache, handle);
+	e->hash_next = cache->buckets[b];
+	cache->buckets[b] = e;
+	lru_push_front(cache, e);
+	cache->nb_entries++;
+	pthread_mutex_unlock(&cache->lock);
+	
+	return e->roundkeys;
+}
+
+
+void key_cache_release(key_cache * cache, uint8_t ** roundkeys){
+	key_cache_entry * e = (key_cache_entry *)((uint8_t *)roundkeys - offsetof(key_cache_entry, roundkeys));
+	
+	pthread_mutex_lock(&cache->lock);
+	e->refcount--;
+	if(e->refcount == 0 && cache->nb_entries > cache->max_entries){
+		// the cache grew over its limit while every entry was pinned
+		remove_entry(cache, e);
+		cache->evictions++;
+	}
+	pthread_mutex_unlock(&cache->lock);
+}
+
+
+void key_cache_get_stats(key_cache * cache, key_cache_stats * stats){
+	pthread_mutex_lock(&cache->lock);
+	stats->hits = cache->hits;
+	stats->misses = cache->misses;
+	stats->evictions = cache->evictions;
+	stats->entries = cache->nb_entries;
+	stats->bytes = cache->nb_entries * sizeof(key_cache_entry);
+	stats->max_bytes = cache->max_bytes;
+	pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,96 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#ifndef KEY_CACHE_H
+#define KEY_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes128_sharing.h"
+
+/**********************************************************
+ * Bounded, thread safe LRU cache of n-share round keys,
+ * indexed by a key handle. On a miss, the key of the 
+ * handle is fetched with the loader callback, expanded
+ * with aes_key_expansion_128 and shared with 
+ * generate_n_sharing.
+ * 
+ * key_cache_acquire returns the n-share round keys in the
+ * form expected by the roundkeys argument of 
+ * aes_encrypt_128_sharing / aes_decrypt_128_sharing. The
+ * entry is pinned (it cannot be evicted) until it is 
+ * given back with key_cache_release.
+ * 
+ * The memory limit bounds the number of cached entries 
+ * (each one takes about AES_ROUND_KEY_SIZE * 
+ * (NB_SHARES + sizeof(uint8_t *)) bytes). It is only 
+ * exceeded when all the entries are pinned.
+**********************************************************/
+
+/**********************************************************
+ * Writes the AES_BLOCK_SIZE byte key of handle into key.
+ * Returns 0 on success, -1 if the handle is unknown
+**********************************************************/
+typedef int (*key_cache_loader)(void * ctx, uint64_t handle, uint8_t * key);
+
+typedef struct key_cache key_cache;
+
+typedef struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	size_t entries;
+	size_t bytes;
+	size_t max_bytes;
+} key_cache_stats;
+
+
+key_cache * key_cache_new(size_t max_bytes, key_cache_loader loader, void * ctx);
+
+void key_cache_free(key_cache * cache);
+
+
+/**********************************************************
+ * Returns the n-share round keys of handle, or NULL if
+ * the loader does not know the handle
+**********************************************************/
+uint8_t ** key_cache_acquire(key_cache * cache, uint64_t handle);
+
+void key_cache_release(key_cache * cache, uint8_t ** roundkeys);
+
+
+/**********************************************************
+ * Size in bytes of one cache entry
+**********************************************************/
+size_t key_cache_entry_size(void);
+
+void key_cache_get_stats(key_cache * cache, key_cache_stats * stats);
+
+#endif
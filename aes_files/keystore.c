@@ -0,0 +1,254 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "keystore.h"
+
+#include "gadgets.h"
+
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t nb_shares;
+	uint64_t nb_keys;
+	uint64_t record_size;
+	uint64_t data_offset;
+	uint64_t checksum;
+	uint8_t reserved[16];
+} keystore_header;
+
+_Static_assert(sizeof(keystore_header) == 64, "the header is one cache line");
+
+static const char keystore_magic[8] = "AESKEYS";
+
+#define KEY_SHARING_SIZE (AES_ROUND_KEY_SIZE * NB_SHARES)
+#define RECORD_SIZE      ((KEY_SHARING_SIZE + 63) / 64 * 64)
+
+// records written per write call
+#define WRITE_RECORDS 256
+
+struct keystore {
+	uint8_t * map;
+	size_t map_len;
+	size_t nb_keys;
+};
+
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+// len is a multiple of 8
+static uint64_t checksum_words(uint64_t h, const uint8_t * p, size_t len){
+	uint64_t w;
+	for(size_t i = 0; i < len; i += 8){
+		memcpy(&w, p + i, 8);
+		h = (h ^ w) * FNV_PRIME;
+	}
+	return h;
+}
+
+
+static int write_full(int fd, const uint8_t * buf, size_t len){
+	while(len > 0){
+		ssize_t n = write(fd, buf, len);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+
+int keystore_write(const char * path, const uint8_t * sharings, size_t nb_keys){
+	uint8_t page[KEYSTORE_DATA_OFFSET] = { 0 };
+	keystore_header * header = (keystore_header *)page;
+	char * tmp_path = (char *)malloc(strlen(path) + 5);
+	uint8_t * records = (uint8_t *)calloc(WRITE_RECORDS, RECORD_SIZE);
+	int fd = -1, ret = -1;
+	
+	if(tmp_path == NULL || records == NULL)
+		goto end;
+	sprintf(tmp_path, "%s.tmp", path);
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if(fd < 0)
+		goto end;
+	
+	memcpy(header->magic, keystore_magic, sizeof(header->magic));
+	header->version = KEYSTORE_VERSION;
+	header->nb_shares = NB_SHARES;
+	header->nb_keys = nb_keys;
+	header->record_size = RECORD_SIZE;
+	header->data_offset = KEYSTORE_DATA_OFFSET;
+	uint64_t h = checksum_words(FNV_OFFSET, page, sizeof(keystore_header));
+	
+	// the records, then the first page once the checksum is known
+	if(lseek(fd, KEYSTORE_DATA_OFFSET, SEEK_SET) < 0)
+		goto end;
+	for(size_t k = 0; k < nb_keys; k += WRITE_RECORDS){
+		size_t n = nb_keys - k < WRITE_RECORDS ? nb_keys - k : WRITE_RECORDS;
+		for(size_t j = 0; j < n; j++){
+			memcpy(records + j * RECORD_SIZE, sharings + (k + j) * KEY_SHARING_SIZE, KEY_SHARING_SIZE);
+		}
+		h = checksum_words(h, records, n * RECORD_SIZE);
+		if(write_full(fd, records, n * RECORD_SIZE) < 0)
+			goto end;
+	}
+	header->checksum = h;
+	if(pwrite(fd, page, sizeof(page), 0) != sizeof(page) || fsync(fd) < 0)
+		goto end;
+	
+	if(close(fd) == 0 && rename(tmp_path, path) == 0)
+		ret = 0;
+	fd = -1;
+	
+end:
+	if(fd >= 0)
+		close(fd);
+	if(ret < 0 && tmp_path != NULL)
+		unlink(tmp_path);
+	free(tmp_path);
+	free(records);
+	return ret;
+}
+
+
+static int check_header(const keystore_header * header, size_t file_len){
+	if(memcmp(header->magic, keystore_magic, sizeof(header->magic)) != 0 || header->version != KEYSTORE_VERSION
+		|| header->nb_shares != NB_SHARES || header->record_size != RECORD_SIZE || header->data_offset != KEYSTORE_DATA_OFFSET)
+		return -1;
+	if(header->nb_keys > (file_len - KEYSTORE_DATA_OFFSET) / RECORD_SIZE)
+		return -1;
+	return 0;
+}
+
+
+keystore * keystore_open(const char * path, int flags){
+	keystore * store = NULL;
+	struct stat st;
+	uint8_t * map = MAP_FAILED;
+	int err;
+	
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+	if(fstat(fd, &st) < 0)
+		goto error;
+	if(st.st_size < KEYSTORE_DATA_OFFSET){
+		errno = EINVAL;
+		goto error;
+	}
+	
+	// a private writable mapping is only needed to re-randomize
+	if(flags & KEYSTORE_RERANDOMIZE)
+		map = (uint8_t *)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	else
+		map = (uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if(map == MAP_FAILED)
+		goto error;
+	
+	keystore_header header;
+	memcpy(&header, map, sizeof(header));
+	if(check_header(&header, st.st_size) < 0){
+		errno = EINVAL;
+		goto error;
+	}
+	
+	if(flags & KEYSTORE_VERIFY){
+		uint64_t checksum = header.checksum;
+		header.checksum = 0;
+		uint64_t h = checksum_words(FNV_OFFSET, (const uint8_t *)&header, sizeof(header));
+		h = checksum_words(h, map + KEYSTORE_DATA_OFFSET, header.nb_keys * RECORD_SIZE);
+		if(h != checksum){
+			errno = EBADMSG;
+			goto error;
+		}
+	}
+	
+	if(flags & KEYSTORE_RERANDOMIZE){
+		for(size_t k = 0; k < header.nb_keys; k++){
+			refresh_n_sharing_buffer(map + KEYSTORE_DATA_OFFSET + k * RECORD_SIZE, AES_ROUND_KEY_SIZE);
+		}
+	}
+	
+	store = (keystore *)malloc(sizeof(keystore));
+	if(store == NULL){
+		errno = ENOMEM;
+		goto error;
+	}
+	store->map = map;
+	store->map_len = st.st_size;
+	store->nb_keys = header.nb_keys;
+	close(fd);
+	return store;
+	
+error:
+	err = errno;
+	if(map != MAP_FAILED)
+		munmap(map, st.st_size);
+	close(fd);
+	errno = err;
+	return NULL;
+}
+
+
+void keystore_close(keystore * store){
+	if(store == NULL)
+		return;
+	munmap(store->map, store->map_len);
+	free(store);
+}
+
+
+size_t keystore_nb_keys(const keystore * store){
+	return store->nb_keys;
+}
+
+
+uint8_t ** keystore_roundkeys(const keystore * store, size_t k, uint8_t ** ptrs){
+	uint8_t * record = store->map + KEYSTORE_DATA_OFFSET + k * RECORD_SIZE;
+	for(int i = 0; i < AES_ROUND_KEY_SIZE; i++){
+		ptrs[i] = record + i * NB_SHARES;
+	}
+	return ptrs;
+}
@@ -0,0 +1,113 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+
+#ifndef KEYSTORE_H
+#define KEYSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes128_sharing.h"
+
+/**********************************************************
+ * On-disk store of n-share round keys, mapped read-only
+ * at startup instead of expanding and sharing every key
+ * again.
+ * 
+ * Format (version KEYSTORE_VERSION, host byte order):
+ *   [0, 64)  header: magic "AESKEYS\0", version, 
+ *            NB_SHARES, number of keys, record size, 
+ *            offset of the records, checksum
+ *   [KEYSTORE_DATA_OFFSET, ...) one record per key
+ * A record is the AES_ROUND_KEY_SIZE * NB_SHARES bytes of
+ * the round key sharings of a key, in the layout of the
+ * buffer of generate_roundkeys_sharing (share s of round
+ * key byte i at i * NB_SHARES + s), padded to a multiple
+ * of 64 bytes, so that every record starts on a cache 
+ * line of the page aligned mapping.
+ * The checksum is a 64-bit FNV-1a over the 64-bit words 
+ * of the header (with a zero checksum field) and of the
+ * records. A store written with another NB_SHARES, 
+ * version or byte order is rejected.
+**********************************************************/
+#define KEYSTORE_VERSION     1
+#define KEYSTORE_DATA_OFFSET 4096
+
+
+/**********************************************************
+ * sharings : nb_keys records of AES_ROUND_KEY_SIZE * 
+ * NB_SHARES bytes, one after the other (e.g. the buf of a
+ * roundkeys_table, see aes128_batch.h)
+ * Writes the store to path (through a temporary file 
+ * renamed at the end, so that a reader never sees a 
+ * partial store). Returns 0 on success, -1 otherwise
+**********************************************************/
+int keystore_write(const char * path, const uint8_t * sharings, size_t nb_keys);
+
+
+typedef struct keystore keystore;
+
+/**********************************************************
+ * The checksum is checked by keystore_open with 
+ * KEYSTORE_VERIFY (this reads the whole store).
+ * With KEYSTORE_RERANDOMIZE, the store is mapped 
+ * privately (copy on write) and every key is refreshed 
+ * with refresh_n_sharing_buffer, so that the process does
+ * not use the shares stored on disk (the file itself is
+ * not modified).
+**********************************************************/
+#define KEYSTORE_VERIFY      1
+#define KEYSTORE_RERANDOMIZE 2
+
+/**********************************************************
+ * Maps the store at path. Returns NULL, with errno set, 
+ * if the file cannot be mapped (errno of open / mmap), is
+ * not a store for this NB_SHARES (EINVAL) or has a wrong
+ * checksum (EBADMSG)
+**********************************************************/
+keystore * keystore_open(const char * path, int flags);
+
+void keystore_close(keystore * store);
+
+size_t keystore_nb_keys(const keystore * store);
+
+
+/**********************************************************
+ * ptrs : array of AES_ROUND_KEY_SIZE pointers
+ * Fills ptrs with the n-share round keys of key k, 
+ * pointing into the mapping, and returns ptrs: it is the
+ * roundkeys argument of aes_encrypt_128_sharing (and of 
+ * the batch interfaces), valid until keystore_close. 
+ * Without KEYSTORE_RERANDOMIZE the mapping is read-only,
+ * so the round keys must not be refreshed in place.
+**********************************************************/
+uint8_t ** keystore_roundkeys(const keystore * store, size_t k, uint8_t ** ptrs);
+
+#endif
@@ -0,0 +1,250 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+
+typedef struct {
+	parallel_fn fn;
+	void * ctx;
+	size_t begin;
+	size_t end;
+} parallel_range;
+
+
+static void * parallel_worker(void * arg){
+	parallel_range * range = (parallel_range *)arg;
+	range->fn(range->ctx, range->begin, range->end);
+	return NULL;
+}
+
+
+void run_parallel(parallel_fn fn, void * ctx, size_t nb_items, int nb_threads){
+	int t;
+	
+	if(nb_threads < 1)
+		nb_threads = 1;
+	if((size_t)nb_threads > nb_items)
+		nb_threads = nb_items;
+	if(nb_threads <= 1){
+		if(nb_items > 0)
+			fn(ctx, 0, nb_items);
+		return;
+	}
+	
+	pthread_t * threads = (pthread_t *)malloc(nb_threads * sizeof(pthread_t));
+	parallel_range * ranges = (parallel_range *)malloc(nb_threads * sizeof(parallel_range));
+	char * started = (char *)calloc(nb_threads, sizeof(char));
+	
+	size_t chunk = nb_items / nb_threads;
+	size_t extra = nb_items % nb_threads;
+	size_t begin = 0;
+	for(t = 0; t < nb_threads; t++){
+		ranges[t].fn = fn;
+		ranges[t].ctx = ctx;
+		ranges[t].begin = begin;
+		ranges[t].end = begin + chunk + ((size_t)t < extra ? 1 : 0);
+		begin = ranges[t].end;
+	}
+	
+	for(t = 1; t < nb_threads; t++){
+		if(pthread_create(&threads[t], NULL, parallel_worker, &ranges[t]) == 0)
+			started[t] = 1;
+		else
+			parallel_worker(&ranges[t]);    // could not spawn the thread, run its range here
+	}
+	parallel_worker(&ranges[0]);
+	for(t = 1; t < nb_threads; t++){
+		if(started[t])
+			pthread_join(threads[t], NULL);
+	}
+	
+	free(started);
+	free(ranges);
+	free(threads);
+}
+
+
+int parallel_default_threads(void){
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n < 1 ? 1 : (int)n;
+}
+
+
+int bounded_queue_init(bounded_queue * q, size_t capacity){
+	if(capacity == 0)
+		return -1;
+	q->items = (void **)malloc(capacity * sizeof(void *));
+	if(!q->items)
+		return -1;
+	q->capacity = capacity;
+	q->head = 0;
+	q->count = 0;
+	q->closed = 0;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->not_empty, NULL);
+	pthread_cond_init(&q->not_full, NULL);
+	return 0;
+}
+
+
+void bounded_queue_destroy(bounded_queue * q){
+	pthread_cond_destroy(&q->not_full);
+	pthread_cond_destroy(&q->not_empty);
+	pthread_mutex_destroy(&q->lock);
+	free(q->items);
+}
+
+
+int bounded_queue_push(bounded_queue * q, void * item){
+	pthread_mutex_lock(&q->lock);
+	while(q->count == q->capacity && !q->closed){
+		pthread_cond_wait(&q->not_full, &q->lock);
+	}
+	if(q->closed){
+		pthread_mutex_unlock(&q->lock);
+		return -1;
+	}
+	q->items[(q->head + q->count) % q->capacity] = item;
+	q->count++;
+	pthread_cond_signal(&q->not_empty);
+	pthread_mutex_unlock(&q->lock);
+	return 0;
+}
+
+
+void * bounded_queue_pop(bounded_queue * q){
+	void * item = NULL;
+	
+	pthread_mutex_lock(&q->lock);
+	while(q->count == 0 && !q->closed){
+		pthread_cond_wait(&q->not_empty, &q->lock);
+	}
+	if(q->count > 0){
+		item = q->items[q->head];
+		q->head = (q->head + 1) % q->capacity;
+		q->count--;
+		pthread_cond_signal(&q->not_full);
+	}
+	pthread_mutex_unlock(&q->lock);
+	return item;
+}
+
+
+void bounded_queue_close(bounded_queue * q){
+	pthread_mutex_lock(&q->lock);
+	q->closed = 1;
+	pthread_cond_broadcast(&q->not_empty);
+	pthread_cond_broadcast(&q->not_full);
+	pthread_mutex_unlock(&q->lock);
+}
+
+
+#define SPIN_BEFORE_YIELD 128
+
+int spsc_queue_init(spsc_queue * q, size_t capacity){
+	size_t size = 1;
+	
+	if(capacity == 0)
+		return -1;
+	while(size < capacity){
+		size <<= 1;
+	}
+	q->items = (void **)malloc(size * sizeof(void *));
+	if(!q->items)
+		return -1;
+	q->mask = size - 1;
+	atomic_init(&q->head, 0);
+	atomic_init(&q->tail, 0);
+	return 0;
+}
+
+
+void spsc_queue_destroy(spsc_queue * q){
+	free(q->items);
+}
+
+
+void spsc_queue_push(spsc_queue * q, void * item){
+	size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+	int spins = 0;
+	
+	while(tail - atomic_load_explicit(&q->head, memory_order_acquire) > q->mask){
+		if(++spins > SPIN_BEFORE_YIELD)
+			sched_yield();
+	}
+	q->items[tail & q->mask] = item;
+	atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+}
+
+
+void * spsc_queue_pop(spsc_queue * q){
+	size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	int spins = 0;
+	
+	while(atomic_load_explicit(&q->tail, memory_order_acquire) == head){
+		if(++spins > SPIN_BEFORE_YIELD)
+			sched_yield();
+	}
+	void * item = q->items[head & q->mask];
+	atomic_store_explicit(&q->head, head + 1, memory_order_release);
+	return item;
+}
+
+
+void spin_barrier_init(spin_barrier * b, int nb_threads){
+	atomic_init(&b->count, 0);
+	atomic_init(&b->sense, 0);
+	b->nb_threads = nb_threads;
+}
+
+
+void spin_barrier_wait(spin_barrier * b, int * local_sense){
+	int sense = !*local_sense;
+	int spins = 0;
+	
+	*local_sense = sense;
+	if(atomic_fetch_add_explicit(&b->count, 1, memory_order_acq_rel) == b->nb_threads - 1){
+		// last one in: reset the count and release the others
+		atomic_store_explicit(&b->count, 0, memory_order_relaxed);
+		atomic_store_explicit(&b->sense, sense, memory_order_release);
+		return;
+	}
+	while(atomic_load_explicit(&b->sense, memory_order_acquire) != sense){
+		if(++spins > SPIN_BEFORE_YIELD)
+			sched_yield();
+	}
+}
@@ -0,0 +1,126 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+/**********************************************************
+ * Small thread helpers used by the bulk modes of 
+ * operation. The items [0, nb_items) are split into 
+ * nb_threads contiguous ranges, and each range is given
+ * to fn in its own thread (the calling thread takes the
+ * first range). run_parallel returns once all ranges
+ * are done.
+**********************************************************/
+typedef void (*parallel_fn)(void * ctx, size_t begin, size_t end);
+
+void run_parallel(parallel_fn fn, void * ctx, size_t nb_items, int nb_threads);
+
+
+/**********************************************************
+ * Returns the number of online cores (at least 1)
+**********************************************************/
+int parallel_default_threads(void);
+
+
+/**********************************************************
+ * Bounded blocking FIFO queue of pointers, used to connect
+ * the stages of a pipeline. push blocks while the queue 
+ * is full, pop blocks while it is empty. Once the queue
+ * is closed, push fails and pop returns NULL when the
+ * queue is empty.
+**********************************************************/
+typedef struct {
+	void ** items;
+	size_t capacity;
+	size_t head;
+	size_t count;
+	int closed;
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+} bounded_queue;
+
+int bounded_queue_init(bounded_queue * q, size_t capacity);
+
+void bounded_queue_destroy(bounded_queue * q);
+
+int bounded_queue_push(bounded_queue * q, void * item);
+
+void * bounded_queue_pop(bounded_queue * q);
+
+void bounded_queue_close(bounded_queue * q);
+
+
+/**********************************************************
+ * Lock-free single-producer / single-consumer FIFO queue
+ * of pointers, for pipeline stages that exchange items 
+ * at a high rate. push (resp. pop) spins, then yields,
+ * while the queue is full (resp. empty). The capacity is
+ * rounded up to a power of 2. There is no close: the
+ * producer pushes an end marker of its choice.
+**********************************************************/
+typedef struct {
+	_Alignas(64) atomic_size_t head;     // written by the consumer
+	_Alignas(64) atomic_size_t tail;     // written by the producer
+	_Alignas(64) void ** items;
+	size_t mask;
+} spsc_queue;
+
+int spsc_queue_init(spsc_queue * q, size_t capacity);
+
+void spsc_queue_destroy(spsc_queue * q);
+
+void spsc_queue_push(spsc_queue * q, void * item);
+
+void * spsc_queue_pop(spsc_queue * q);
+
+
+/**********************************************************
+ * Sense reversing barrier for a fixed team of nb_threads
+ * threads that meet at a high rate (several times per 
+ * block). wait spins, then yields, until all the threads
+ * of the team have arrived. Each thread keeps its own
+ * sense, initialized to 0.
+**********************************************************/
+typedef struct {
+	_Alignas(64) atomic_int count;
+	_Alignas(64) atomic_int sense;
+	int nb_threads;
+} spin_barrier;
+
+void spin_barrier_init(spin_barrier * b, int nb_threads);
+
+void spin_barrier_wait(spin_barrier * b, int * local_sense);
+
+#endif
@@ -0,0 +1,167 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+#include "perf_trace.h"
+
+
+static const char * phase_names[PERF_NB_PHASES] = { "AddRoundKey", "SubBytes", "ShiftRows", "MixColumns" };
+
+static const char * counter_names[PERF_NB_COUNTERS] = { "cycles", "instructions", "l1d_misses", "branch_misses", "task_clock_ns" };
+
+static const uint32_t counter_types[PERF_NB_COUNTERS] = {
+	PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE
+};
+
+static const uint64_t counter_configs[PERF_NB_COUNTERS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+	PERF_COUNT_HW_BRANCH_MISSES,
+	PERF_COUNT_SW_TASK_CLOCK
+};
+
+static uint64_t totals[PERF_NB_ROUNDS][PERF_NB_PHASES][PERF_NB_COUNTERS];
+static uint64_t calls[PERF_NB_ROUNDS][PERF_NB_PHASES];
+static int available[PERF_NB_COUNTERS];
+
+static _Thread_local int opened = 0;
+static _Thread_local int fds[PERF_NB_COUNTERS];
+static _Thread_local uint64_t start_values[PERF_NB_COUNTERS];
+
+static pthread_once_t fds_once = PTHREAD_ONCE_INIT;
+static pthread_key_t fds_key;
+
+
+// closes the counters of a thread when it exits
+static void close_counters(void * thread_fds){
+	int * f = (int *)thread_fds;
+	for(int c = 0; c < PERF_NB_COUNTERS; c++){
+		if(f[c] >= 0)
+			close(f[c]);
+		f[c] = -1;
+	}
+}
+
+
+static void make_fds_key(void){
+	pthread_key_create(&fds_key, close_counters);
+}
+
+
+static void open_counters(void){
+	struct perf_event_attr attr;
+	
+	for(int c = 0; c < PERF_NB_COUNTERS; c++){
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = counter_types[c];
+		attr.config = counter_configs[c];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fds[c] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if(fds[c] >= 0)
+			__atomic_store_n(&available[c], 1, __ATOMIC_RELAXED);
+	}
+	opened = 1;
+	pthread_once(&fds_once, make_fds_key);
+	pthread_setspecific(fds_key, fds);
+}
+
+
+static void read_counters(uint64_t * values){
+	for(int c = 0; c < PERF_NB_COUNTERS; c++){
+		if(fds[c] < 0 || read(fds[c], &values[c], sizeof(uint64_t)) != sizeof(uint64_t))
+			values[c] = 0;
+	}
+}
+
+
+void perf_trace_begin(void){
+	if(!opened)
+		open_counters();
+	read_counters(start_values);
+}
+
+
+void perf_trace_end(int round, int phase){
+	uint64_t values[PERF_NB_COUNTERS];
+	
+	// without a perf_trace_begin on this thread, only start counting
+	if(!opened){
+		perf_trace_begin();
+		return;
+	}
+	
+	read_counters(values);
+	for(int c = 0; c < PERF_NB_COUNTERS; c++){
+		__atomic_fetch_add(&totals[round][phase][c], values[c] - start_values[c], __ATOMIC_RELAXED);
+	}
+	__atomic_fetch_add(&calls[round][phase], 1, __ATOMIC_RELAXED);
+	
+	// the next phase starts here, so that the reads are not counted twice
+	memcpy(start_values, values, sizeof(values));
+}
+
+
+void perf_trace_reset(void){
+	memset(totals, 0, sizeof(totals));
+	memset(calls, 0, sizeof(calls));
+}
+
+
+void perf_trace_dump_csv(FILE * f){
+	fprintf(f, "round,phase,calls");
+	for(int c = 0; c < PERF_NB_COUNTERS; c++){
+		fprintf(f, ",%s", counter_names[c]);
+	}
+	fprintf(f, "\n");
+	
+	for(int r = 0; r < PERF_NB_ROUNDS; r++){
+		for(int p = 0; p < PERF_NB_PHASES; p++){
+			if(calls[r][p] == 0)
+				continue;
+			fprintf(f, "%d,%s,%llu", r, phase_names[p], (unsigned long long)calls[r][p]);
+			for(int c = 0; c < PERF_NB_COUNTERS; c++){
+				if(available[c])
+					fprintf(f, ",%llu", (unsigned long long)totals[r][p][c]);
+				else
+					fprintf(f, ",-1");
+			}
+			fprintf(f, "\n");
+		}
+	}
+}
@@ -0,0 +1,98 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#ifndef PERF_TRACE_H
+#define PERF_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**********************************************************
+ * Hardware performance counter tracing of the phases of
+ * aes_encrypt_128_sharing, and of the equivalent inverse
+ * cipher that runs the same rounds (Linux perf_event_open).
+ * 
+ * The counters of the calling thread (user space only) are
+ * read around each phase of each round, and the 
+ * differences are accumulated per (round, phase) for all 
+ * the threads. perf_trace_dump_csv prints the aggregates.
+ * Counters that cannot be opened (no PMU in a virtual
+ * machine, perf_event_paranoid, ...) are reported as -1.
+ * 
+ * The tracing is only compiled in with -DPERF_TRACE 
+ * (make FLAGS="-O0 -DPERF_TRACE"), otherwise the 
+ * PERF_TRACE_BEGIN / PERF_TRACE_END macros are empty and
+ * cost nothing.
+**********************************************************/
+
+#define PERF_PHASE_ADD_ROUND_KEY 0
+#define PERF_PHASE_SUB_BYTES     1
+#define PERF_PHASE_SHIFT_ROWS    2
+#define PERF_PHASE_MIX_COLUMNS   3
+#define PERF_NB_PHASES           4
+
+#define PERF_COUNTER_CYCLES        0
+#define PERF_COUNTER_INSTRUCTIONS  1
+#define PERF_COUNTER_L1D_MISSES    2
+#define PERF_COUNTER_BRANCH_MISSES 3
+#define PERF_COUNTER_TASK_CLOCK    4
+#define PERF_NB_COUNTERS           5
+
+#define PERF_NB_ROUNDS 11
+
+
+/**********************************************************
+ * Snapshots the counters of the calling thread
+**********************************************************/
+void perf_trace_begin(void);
+
+
+/**********************************************************
+ * Adds the counter increments since the last 
+ * perf_trace_begin / perf_trace_end of the calling thread
+ * to the aggregates of (round, phase). The next phase is
+ * counted from there, so consecutive phases only need one
+ * perf_trace_begin
+**********************************************************/
+void perf_trace_end(int round, int phase);
+
+void perf_trace_reset(void);
+
+void perf_trace_dump_csv(FILE * f);
+
+
+#ifdef PERF_TRACE
+#define PERF_TRACE_BEGIN()            perf_trace_begin()
+#define PERF_TRACE_END(round, phase)  perf_trace_end(round, phase)
+#else
+#define PERF_TRACE_BEGIN()
+#define PERF_TRACE_END(round, phase)
+#endif
+
+#endif
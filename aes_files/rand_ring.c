@@ -0,0 +1,264 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "rand_ring.h"
+
+
+_Thread_local rand_ring * rand_ring_current = NULL;
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+static rand_ring_stats totals;
+
+#define SPIN_BEFORE_YIELD 64
+#define SPIN_BEFORE_PARK  1024
+
+
+static uint64_t rotl(uint64_t x, int k){
+	return (x << k) | (x >> (64 - k));
+}
+
+/* xoshiro256** */
+static uint64_t next_rand(uint64_t * s){
+	uint64_t res = rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+	return res;
+}
+
+
+static void futex_wait(atomic_int * addr, int val){
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_int * addr){
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+
+/**********************************************************
+ * The producer announces that it sleeps (parked = 1) 
+ * before checking the ring and the stop flag a last time,
+ * the consumer publishes its tail (or stop) before 
+ * checking parked: with sequentially consistent accesses
+ * on both sides, one of them sees the other. The inline 
+ * path of rand_ring_get only checks parked with a relaxed
+ * load, which can miss a wake-up for one publication; 
+ * rand_ring_refill does the full handshake before the 
+ * consumer waits, so that both never sleep at once.
+**********************************************************/
+void rand_ring_wake(rand_ring * r){
+	if(atomic_exchange(&r->parked, 0))
+		futex_wake(&r->parked);
+}
+
+
+static void * producer(void * arg){
+	rand_ring * r = (rand_ring *)arg;
+	size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+	int spins = 0;
+	
+	while(!atomic_load_explicit(&r->stop, memory_order_relaxed)){
+		if(RAND_RING_SIZE - (head - tail) < RAND_RING_BATCH){
+			tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+			if(RAND_RING_SIZE - (head - tail) < RAND_RING_BATCH){
+				// back-pressure: the consumer is behind
+				if(spins++ == 0)
+					r->producer_waits++;
+				if(spins > SPIN_BEFORE_PARK){
+					atomic_store(&r->parked, 1);
+					tail = atomic_load(&r->tail);
+					if(RAND_RING_SIZE - (head - tail) < RAND_RING_BATCH && !atomic_load(&r->stop))
+						futex_wait(&r->parked, 1);
+					atomic_store(&r->parked, 0);
+					spins = 1;
+				}
+				else if(spins > SPIN_BEFORE_YIELD)
+					sched_yield();
+				continue;
+			}
+		}
+		spins = 0;
+		
+		size_t pos = head & (RAND_RING_SIZE - 1);
+		for(int i = 0; i < RAND_RING_BATCH; i += 8){
+			uint64_t v = next_rand(r->seed);
+			memcpy(r->buf + pos + i, &v, 8);
+		}
+		head += RAND_RING_BATCH;
+		r->produced += RAND_RING_BATCH;
+		atomic_store_explicit(&r->head, head, memory_order_release);
+	}
+	return NULL;
+}
+
+
+static void ring_destroy(void * arg){
+	rand_ring * r = (rand_ring *)arg;
+	
+	atomic_store(&r->stop, 1);
+	rand_ring_wake(r);
+	pthread_join(r->producer, NULL);
+	
+	__atomic_fetch_add(&totals.consumed, r->local_tail, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&totals.produced, r->produced, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&totals.starvations, r->starvations, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&totals.producer_waits, r->producer_waits, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&totals.rings, 1, __ATOMIC_RELAXED);
+	
+	memset(r->buf, 0, sizeof(r->buf));
+	free(r);
+	if(rand_ring_current == r)
+		rand_ring_current = NULL;
+}
+
+
+static void make_key(void){
+	pthread_key_create(&ring_key, ring_destroy);
+}
+
+
+static void attach(void){
+	rand_ring * r = (rand_ring *)aligned_alloc(64, sizeof(rand_ring));
+	if(!r){
+		fprintf(stderr, "rand_ring: out of memory\n");
+		abort();
+	}
+	memset(r, 0, sizeof(rand_ring));
+	atomic_init(&r->head, 0);
+	atomic_init(&r->tail, 0);
+	atomic_init(&r->stop, 0);
+	atomic_init(&r->parked, 0);
+	
+	FILE * f = fopen("/dev/urandom", "rb");
+	if(!f || fread(r->seed, sizeof(r->seed), 1, f) != 1){
+		// should not happen on Linux, still get a usable seed
+		r->seed[0] = (uint64_t)time(NULL);
+		r->seed[1] = (uint64_t)(uintptr_t)r;
+		r->seed[2] = 0x9e3779b97f4a7c15ULL;
+		r->seed[3] = 0xbf58476d1ce4e5b9ULL;
+	}
+	if(f)
+		fclose(f);
+	
+	if(pthread_create(&r->producer, NULL, producer, r) != 0){
+		fprintf(stderr, "rand_ring: could not start the producer thread\n");
+		abort();
+	}
+	pthread_once(&key_once, make_key);
+	pthread_setspecific(ring_key, r);
+	rand_ring_current = r;
+}
+
+
+void rand_ring_refill(void){
+	rand_ring * r = rand_ring_current;
+	int spins = 0;
+	
+	if(!r){
+		attach();
+		r = rand_ring_current;
+	}
+	
+	r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+	if(r->local_tail != r->cached_head)
+		return;
+	
+	// starvation: let the producer know how far we are, and wait for it
+	r->starvations++;
+	atomic_store(&r->tail, r->local_tail);
+	if(atomic_load(&r->parked))
+		rand_ring_wake(r);
+	while(r->local_tail == r->cached_head){
+		if(++spins > SPIN_BEFORE_YIELD)
+			sched_yield();
+		r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+	}
+}
+
+
+void rand_ring_fill(uint8_t * buf, size_t len){
+	while(len > 0){
+		rand_ring * r = rand_ring_current;
+		if(!r || r->local_tail == r->cached_head){
+			rand_ring_refill();
+			r = rand_ring_current;
+		}
+		
+		// contiguous bytes available before the end of the ring
+		size_t pos = r->local_tail & (RAND_RING_SIZE - 1);
+		size_t n = r->cached_head - r->local_tail;
+		if(n > RAND_RING_SIZE - pos)
+			n = RAND_RING_SIZE - pos;
+		if(n > len)
+			n = len;
+		memcpy(buf, r->buf + pos, n);
+		buf += n;
+		len -= n;
+		r->local_tail += n;
+		atomic_store_explicit(&r->tail, r->local_tail, memory_order_release);
+		if(atomic_load_explicit(&r->parked, memory_order_relaxed))
+			rand_ring_wake(r);
+	}
+}
+
+
+void rand_ring_get_stats(rand_ring_stats * stats){
+	rand_ring * r = rand_ring_current;
+	
+	stats->consumed = __atomic_load_n(&totals.consumed, __ATOMIC_RELAXED);
+	stats->produced = __atomic_load_n(&totals.produced, __ATOMIC_RELAXED);
+	stats->starvations = __atomic_load_n(&totals.starvations, __ATOMIC_RELAXED);
+	stats->producer_waits = __atomic_load_n(&totals.producer_waits, __ATOMIC_RELAXED);
+	stats->rings = __atomic_load_n(&totals.rings, __ATOMIC_RELAXED);
+	if(r){
+		stats->consumed += r->local_tail;
+		stats->produced += __atomic_load_n(&r->produced, __ATOMIC_RELAXED);
+		stats->starvations += r->starvations;
+		stats->producer_waits += __atomic_load_n(&r->producer_waits, __ATOMIC_RELAXED);
+		stats->rings++;
+	}
+}
@@ -0,0 +1,150 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#ifndef RAND_RING_H
+#define RAND_RING_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**********************************************************
+ * Background randomness producer (build with -DRAND_RING).
+ * 
+ * Each thread that calls get_rand() gets its own producer
+ * thread, created on the first call, that fills a lock 
+ * free single-producer / single-consumer ring of random
+ * bytes (xoshiro256** seeded from /dev/urandom). The 
+ * gadgets then only read bytes from the ring, and the
+ * generation runs on a sibling core in parallel with the
+ * GF(256) arithmetic. The producer is stopped when its
+ * consumer thread exits.
+ * 
+ * The consumer only publishes its position every 
+ * RAND_RING_PUBLISH bytes, and the producer writes 
+ * RAND_RING_BATCH bytes at a time, to limit the cache
+ * line transfers between the two cores.
+ * 
+ * When the ring stays full (the consumer is idle), the 
+ * producer spins for a bounded time and then sleeps on a
+ * futex until the consumer frees room in the ring, so 
+ * that an idle thread does not keep a core busy.
+ * 
+ * The rings are per thread: run_parallel starts new 
+ * worker threads at each call, so with -DRAND_RING every
+ * batch call also starts (and joins) one producer thread
+ * per worker and reads its seed from /dev/urandom. This
+ * setup costs some tens of microseconds per worker and 
+ * call, which is only amortized by batches of many blocks.
+ * 
+ * Metrics: a starvation is a get_rand() that finds the
+ * ring empty and waits for the producer, a producer wait
+ * is a batch that has to wait for room in the ring 
+ * (back-pressure).
+**********************************************************/
+
+#define RAND_RING_SIZE     (1 << 16)   // must be a power of 2
+#define RAND_RING_BATCH    256
+#define RAND_RING_PUBLISH  64
+
+typedef struct {
+	_Alignas(64) atomic_size_t head;     // written by the producer
+	_Alignas(64) atomic_size_t tail;     // written by the consumer
+	_Alignas(64) size_t local_tail;      // consumer side copies
+	size_t cached_head;
+	uint64_t starvations;
+	_Alignas(64) uint64_t producer_waits;
+	uint64_t produced;
+	atomic_int stop;
+	atomic_int parked;                   // the producer sleeps on it
+	pthread_t producer;
+	uint64_t seed[4];
+	_Alignas(64) uint8_t buf[RAND_RING_SIZE];
+} rand_ring;
+
+typedef struct {
+	uint64_t consumed;
+	uint64_t produced;
+	uint64_t starvations;
+	uint64_t producer_waits;
+	uint64_t rings;
+} rand_ring_stats;
+
+extern _Thread_local rand_ring * rand_ring_current;
+
+
+/**********************************************************
+ * Slow path of rand_ring_get: attaches a ring to the 
+ * calling thread if needed, and waits until bytes are
+ * available
+**********************************************************/
+void rand_ring_refill(void);
+
+
+/**********************************************************
+ * Wakes the producer of r when it sleeps on a full ring
+**********************************************************/
+void rand_ring_wake(rand_ring * r);
+
+
+/**********************************************************
+ * Returns the next random byte of the calling thread
+**********************************************************/
+static inline uint8_t rand_ring_get(void){
+	rand_ring * r = rand_ring_current;
+	if(!r || r->local_tail == r->cached_head){
+		rand_ring_refill();
+		r = rand_ring_current;
+	}
+	uint8_t v = r->buf[r->local_tail & (RAND_RING_SIZE - 1)];
+	r->local_tail++;
+	if((r->local_tail & (RAND_RING_PUBLISH - 1)) == 0){
+		atomic_store_explicit(&r->tail, r->local_tail, memory_order_release);
+		if(atomic_load_explicit(&r->parked, memory_order_relaxed))
+			rand_ring_wake(r);
+	}
+	return v;
+}
+
+
+/**********************************************************
+ * Copies the next len random bytes of the calling thread
+ * to buf (bulk version of rand_ring_get)
+**********************************************************/
+void rand_ring_fill(uint8_t * buf, size_t len);
+
+
+/**********************************************************
+ * Statistics of all the rings (the ones of the threads
+ * that exited, and the one of the calling thread)
+**********************************************************/
+void rand_ring_get_stats(rand_ring_stats * stats);
+
+#endif
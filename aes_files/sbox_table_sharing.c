@@ -0,0 +1,185 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbox_table_sharing.h"
+
+
+static const uint8_t sbox[256] = {
+	0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+	0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+	0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+	0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+	0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+	0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+	0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+	0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+	0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+	0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+	0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+	0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+	0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+	0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+	0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+	0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static const uint8_t inv_sbox[256] = {
+	0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
+	0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87, 0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
+	0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
+	0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2, 0x76, 0x5b, 0xa2, 0x49, 0x6d, 0x8b, 0xd1, 0x25,
+	0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16, 0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92,
+	0x6c, 0x70, 0x48, 0x50, 0xfd, 0xed, 0xb9, 0xda, 0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
+	0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a, 0xf7, 0xe4, 0x58, 0x05, 0xb8, 0xb3, 0x45, 0x06,
+	0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02, 0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b,
+	0x3a, 0x91, 0x11, 0x41, 0x4f, 0x67, 0xdc, 0xea, 0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
+	0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
+	0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89, 0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
+	0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
+	0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
+	0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d, 0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
+	0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
+	0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d
+};
+
+
+/**********************************************************
+ * The table is stored share by share: t[j * 256 + u] is
+ * the share j of T(u), so that shifting by a share of x
+ * is a permutation of each 256 bytes plane. The planes 
+ * are handled as 32 words of 8 bytes: u + x moves word
+ * u / 8 to word (u / 8) + (x / 8), and permutes the bytes
+ * of the word by k -> k + (x % 8), i.e. swaps bytes, 
+ * 16-bit halves and 32-bit halves according to the bits
+ * of x (without branching on the share).
+**********************************************************/
+#define PLANE_WORDS 32
+
+static uint64_t xor_byte_index(uint64_t w, uint8_t x){
+	uint64_t m, s;
+	
+	m = -(uint64_t)(x & 1);
+	s = ((w >> 8) & 0x00ff00ff00ff00ffULL) | ((w & 0x00ff00ff00ff00ffULL) << 8);
+	w = (w & ~m) | (s & m);
+	m = -(uint64_t)((x >> 1) & 1);
+	s = ((w >> 16) & 0x0000ffff0000ffffULL) | ((w & 0x0000ffff0000ffffULL) << 16);
+	w = (w & ~m) | (s & m);
+	m = -(uint64_t)((x >> 2) & 1);
+	s = (w >> 32) | (w << 32);
+	w = (w & ~m) | (s & m);
+	return w;
+}
+
+
+/**********************************************************
+ * The two tables (256 n-share entries each) are in a 
+ * thread local buffer, allocated on the first call of the
+ * thread and freed when it exits, so that the scratch 
+ * arena of gadgets.h does not grow at the orders where 
+ * the polynomial S-box is used.
+**********************************************************/
+static _Thread_local uint64_t * tables = NULL;
+
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+static pthread_key_t tables_key;
+
+static void tables_make_key(void){
+	pthread_key_create(&tables_key, free);
+}
+
+
+static uint64_t * thread_tables(void){
+	if(!tables){
+		tables = (uint64_t *)malloc(2 * NB_SHARES * 256);
+		if(!tables){
+			fprintf(stderr, "sbox table: out of memory\n");
+			abort();
+		}
+		pthread_once(&tables_once, tables_make_key);
+		pthread_setspecific(tables_key, tables);
+	}
+	return tables;
+}
+
+
+static void table_recomputation(const uint8_t * table, uint8_t * x, uint8_t * out){
+	uint64_t * t = thread_tables();
+	uint64_t * next = t + NB_SHARES * PLANE_WORDS, * swap;
+	uint64_t r[PLANE_WORDS];
+	uint8_t shares[NB_SHARES];
+	int i, j, w;
+	
+	memcpy(shares, x, NB_SHARES);
+	
+	// T(u) = (S(u), 0, ..., 0)
+	memcpy(t, table, 256);
+	memset(t + PLANE_WORDS, 0, (NB_SHARES - 1) * 256);
+	
+	for(i = 0; i < NB_SHARES - 1; i++){
+		uint8_t lo = shares[i] & 7, hi = shares[i] >> 3;
+		uint64_t * last = next + (NB_SHARES - 1) * PLANE_WORDS;
+		
+		// T(u) = RefreshMasks(T(u + x_i))
+		for(w = 0; w < PLANE_WORDS; w++){
+			last[w] = xor_byte_index(t[(NB_SHARES - 1) * PLANE_WORDS + (w ^ hi)], lo);
+		}
+		for(j = 0; j < NB_SHARES - 1; j++){
+			get_rand_buffer((uint8_t *)r, 256);
+			for(w = 0; w < PLANE_WORDS; w++){
+				uint64_t rw = r[w];
+				next[j * PLANE_WORDS + w] = xor_byte_index(t[j * PLANE_WORDS + (w ^ hi)], lo) ^ rw;
+				last[w] ^= rw;
+			}
+		}
+		
+		swap = t;
+		t = next;
+		next = swap;
+	}
+	
+	uint8_t xn = shares[NB_SHARES - 1];
+	for(j = 0; j < NB_SHARES; j++){
+		out[j] = ((uint8_t *)t)[j * 256 + xn];
+	}
+}
+
+
+void get_sbox_value_sharing_table(uint8_t * x, uint8_t * out){
+	table_recomputation(sbox, x, out);
+}
+
+
+void get_inv_sbox_value_sharing_table(uint8_t * x, uint8_t * out){
+	table_recomputation(inv_sbox, x, out);
+}
@@ -0,0 +1,79 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#ifndef SBOX_TABLE_SHARING_H
+#define SBOX_TABLE_SHARING_H
+
+#include <stdint.h>
+
+#include "gadgets.h"
+
+/**********************************************************
+ * n-share S-box by table recomputation:
+ * 
+ * "Higher Order Masking of Look-up Tables"
+ * By Jean-Sébastien Coron
+ * In the proceedings of EUROCRYPT 2014.
+ * 
+ * The 256 entries table is itself n-share, and is 
+ * shifted by each of the first n - 1 shares of the input 
+ * in turn (T(u) <- RefreshMasks(T(u + x_i))), so that the
+ * output is the entry of the last share. Its cost grows 
+ * in 256 n^2 byte operations, against a fixed number of 
+ * gadgets for the polynomial S-box of aes128_sharing.c, 
+ * so it is only faster at low orders.
+ * 
+ * get_sbox_value_sharing and get_inv_sbox_value_sharing
+ * use it when NB_SHARES <= SBOX_TABLE_MAX_SHARES (see 
+ * ./bench sbox to choose the threshold, 0 disables it).
+ * Measured with ./bench sbox (GCC, x86-64): at -O0, the
+ * Makefile default, it is about 5-10% faster than the 
+ * polynomial with 2 shares and about 30-50% slower with
+ * 3 shares; at -O2 it is already about 25% slower with 
+ * 2 shares. So the default threshold is 2 for builds 
+ * without optimization and 0 otherwise.
+**********************************************************/
+
+#ifndef SBOX_TABLE_MAX_SHARES
+#ifdef __OPTIMIZE__
+#define SBOX_TABLE_MAX_SHARES 0
+#else
+#define SBOX_TABLE_MAX_SHARES 2
+#endif
+#endif
+
+/**********************************************************
+ * x : n-share input variable
+ * out : n-share output variable (can be x)
+**********************************************************/
+void get_sbox_value_sharing_table(uint8_t * x, uint8_t * out);
+
+void get_inv_sbox_value_sharing_table(uint8_t * x, uint8_t * out);
+
+#endif
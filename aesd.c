@@ -0,0 +1,411 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "./aes_files/gadgets.h"
+#include "./aes_files/aes128_sharing.h"
+#include "./aes_files/aes128_batch.h"
+#include "./aes_files/aesd_protocol.h"
+#include "./aes_files/key_cache.h"
+#include "./aes_files/parallel.h"
+
+/**********************************************************
+ * aesd : local n-share AES-128 daemon.
+ * 
+ *    ./aesd [-s socket] [-k nb_keys | -f key_file] 
+ *           [-m cache_bytes] [-t threads] [-b batch_blocks]
+ *           [-w wait_us]
+ * 
+ * The daemon holds nb_keys keys (random ones, or the 
+ * AES_BLOCK_SIZE byte keys stored in key_file), their 
+ * n-share round keys being kept in a key_cache of at most
+ * cache_bytes bytes (by default, large enough for all the
+ * keys). It serves the requests of aesd_protocol.h.
+ * Every connection has its own thread that reads the
+ * requests and masks their data. A single batcher thread
+ * collects the pending requests, waiting at most wait_us
+ * microseconds after the first one or until batch_blocks
+ * blocks are pending, and runs the blocks of each 
+ * (key, operation) pair as one batch over threads cores.
+**********************************************************/
+
+typedef struct aesd_job {
+	aesd_request req;
+	uint8_t * sharing;
+	int32_t status;
+	int grouped;
+	int done;
+	struct aesd_job * next;
+} aesd_job;
+
+static uint8_t * keys;
+static key_cache * cache;
+static uint32_t nb_keys = 16;
+static int nb_threads = 0;
+static size_t batch_blocks = 1024;
+static long batch_wait_us = 200;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond_pending = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t cond_done = PTHREAD_COND_INITIALIZER;
+static aesd_job * pending_head = NULL;
+static aesd_job * pending_tail = NULL;
+static size_t pending_blocks = 0;
+static volatile sig_atomic_t stop = 0;
+
+static uint64_t stat_requests = 0, stat_blocks = 0, stat_batches = 0, stat_max_batch = 0;
+
+
+static int read_full(int fd, void * buf, size_t len){
+	uint8_t * p = (uint8_t *)buf;
+	while(len > 0){
+		ssize_t n = read(fd, p, len);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return -1;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int write_full(int fd, const void * buf, size_t len){
+	const uint8_t * p = (const uint8_t *)buf;
+	while(len > 0){
+		ssize_t n = write(fd, p, len);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return -1;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+
+/**********************************************************
+ * Runs the jobs of list: the blocks of all the jobs that
+ * use the same key and operation form one batch
+**********************************************************/
+static void process_jobs(aesd_job * list, size_t nb_blocks){
+	uint8_t ** blocks = (uint8_t **)malloc(nb_blocks * sizeof(uint8_t *));
+	aesd_job * job, * j;
+	
+	for(job = list; job; job = job->next){
+		job->status = AESD_OK;
+	}
+	
+	for(job = list; job; job = job->next){
+		if(job->grouped)
+			continue;
+		
+		uint8_t ** roundkeys = key_cache_acquire(cache, job->req.key_id);
+		size_t nb = 0;
+		for(j = job; j; j = j->next){
+			if(j->grouped || j->req.key_id != job->req.key_id || j->req.op != job->req.op)
+				continue;
+			for(uint32_t b = 0; b < j->req.nb_blocks; b++){
+				blocks[nb++] = j->sharing + b * AES_BLOCK_SHARING_SIZE;
+			}
+			j->grouped = 1;
+			if(!roundkeys)
+				j->status = AESD_ERR_KEY;
+		}
+		if(!roundkeys)
+			continue;
+		
+		if(job->req.op == AESD_OP_ENCRYPT)
+			aes_encrypt_128_sharing_list(roundkeys, blocks, blocks, nb, nb_threads);
+		else
+			aes_decrypt_128_sharing_list(roundkeys, blocks, blocks, nb, nb_threads);
+		key_cache_release(cache, roundkeys);
+	}
+	
+	free(blocks);
+}
+
+
+static void * batcher(void * arg){
+	aesd_job * list, * job;
+	size_t nb_blocks;
+	struct timespec deadline;
+	
+	(void)arg;
+	pthread_mutex_lock(&lock);
+	while(!stop){
+		while(!pending_head && !stop){
+			pthread_cond_wait(&cond_pending, &lock);
+		}
+		if(stop)
+			break;
+		
+		// coalesce the requests that arrive shortly after the first one
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += batch_wait_us * 1000;
+		deadline.tv_sec += deadline.tv_nsec / 1000000000;
+		deadline.tv_nsec %= 1000000000;
+		while(pending_blocks < batch_blocks && !stop){
+			if(pthread_cond_timedwait(&cond_pending, &lock, &deadline) == ETIMEDOUT)
+				break;
+		}
+		
+		list = pending_head;
+		nb_blocks = pending_blocks;
+		pending_head = pending_tail = NULL;
+		pending_blocks = 0;
+		pthread_mutex_unlock(&lock);
+		
+		process_jobs(list, nb_blocks);
+		
+		pthread_mutex_lock(&lock);
+		stat_batches++;
+		stat_blocks += nb_blocks;
+		if(nb_blocks > stat_max_batch)
+			stat_max_batch = nb_blocks;
+		for(job = list; job; job = job->next){
+			job->done = 1;
+		}
+		pthread_cond_broadcast(&cond_done);
+	}
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+
+static void * connection(void * arg){
+	int fd = (int)(intptr_t)arg;
+	aesd_job job;
+	aesd_response resp;
+	uint8_t * data = (uint8_t *)malloc(AESD_MAX_BLOCKS * AES_BLOCK_SIZE);
+	
+	job.sharing = (uint8_t *)malloc(AESD_MAX_BLOCKS * AES_BLOCK_SHARING_SIZE);
+	
+	while(read_full(fd, &job.req, sizeof(job.req)) == 0){
+		size_t len = (size_t)job.req.nb_blocks * AES_BLOCK_SIZE;
+		resp.magic = AESD_MAGIC;
+		resp.tag = job.req.tag;
+		resp.reserved = 0;
+		resp.nb_blocks = 0;
+		
+		if(job.req.magic != AESD_MAGIC || job.req.nb_blocks > AESD_MAX_BLOCKS
+		   || (job.req.op != AESD_OP_ENCRYPT && job.req.op != AESD_OP_DECRYPT)){
+			resp.status = AESD_ERR_REQUEST;
+			write_full(fd, &resp, sizeof(resp));
+			break;
+		}
+		if(read_full(fd, data, len) != 0)
+			break;
+		
+		generate_n_sharing_buffer(data, job.sharing, len);
+		
+		pthread_mutex_lock(&lock);
+		job.grouped = 0;
+		job.done = 0;
+		job.next = NULL;
+		if(pending_tail)
+			pending_tail->next = &job;
+		else
+			pending_head = &job;
+		pending_tail = &job;
+		pending_blocks += job.req.nb_blocks;
+		stat_requests++;
+		pthread_cond_signal(&cond_pending);
+		while(!job.done){
+			pthread_cond_wait(&cond_done, &lock);
+		}
+		pthread_mutex_unlock(&lock);
+		
+		resp.status = job.status;
+		if(job.status == AESD_OK){
+			resp.nb_blocks = job.req.nb_blocks;
+			compress_n_sharing_buffer(job.sharing, data, len);
+		}
+		if(write_full(fd, &resp, sizeof(resp)) != 0 || (job.status == AESD_OK && write_full(fd, data, len) != 0))
+			break;
+	}
+	
+	close(fd);
+	free(data);
+	free(job.sharing);
+	return NULL;
+}
+
+
+static void on_signal(int sig){
+	(void)sig;
+	stop = 1;
+}
+
+
+static int load_key(void * ctx, uint64_t handle, uint8_t * key){
+	(void)ctx;
+	if(handle >= nb_keys)
+		return -1;
+	memcpy(key, keys + handle * AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+	return 0;
+}
+
+
+static int load_keys(const char * key_file){
+	FILE * f = fopen(key_file ? key_file : "/dev/urandom", "rb");
+	if(!f){
+		perror(key_file ? key_file : "/dev/urandom");
+		return -1;
+	}
+	
+	if(key_file){
+		fseek(f, 0, SEEK_END);
+		nb_keys = ftell(f) / AES_BLOCK_SIZE;
+		fseek(f, 0, SEEK_SET);
+	}
+	keys = (uint8_t *)malloc((size_t)nb_keys * AES_BLOCK_SIZE);
+	if(fread(keys, AES_BLOCK_SIZE, nb_keys, f) != nb_keys){
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	return 0;
+}
+
+
+/**********************************************************
+ * Starts a thread with SIGINT and SIGTERM blocked, so that
+ * they are only delivered to the main thread and interrupt
+ * its accept()
+**********************************************************/
+static int spawn(pthread_t * thread, void * (*routine)(void *), void * arg){
+	sigset_t set, old;
+	int ret;
+	
+	sigemptyset(&set);
+	sigaddset(&set, SIGINT);
+	sigaddset(&set, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+	ret = pthread_create(thread, NULL, routine, arg);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	return ret;
+}
+
+
+int main(int argc, char ** argv){
+	const char * socket_path = AESD_DEFAULT_SOCKET;
+	const char * key_file = NULL;
+	size_t cache_bytes = 0;
+	int opt;
+	
+	while((opt = getopt(argc, argv, "s:k:f:m:t:b:w:")) != -1){
+		switch(opt){
+			case 's': socket_path = optarg; break;
+			case 'k': nb_keys = strtoul(optarg, NULL, 0); break;
+			case 'f': key_file = optarg; break;
+			case 'm': cache_bytes = strtoull(optarg, NULL, 0); break;
+			case 't': nb_threads = atoi(optarg); break;
+			case 'b': batch_blocks = strtoull(optarg, NULL, 0); break;
+			case 'w': batch_wait_us = atol(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-s socket] [-k nb_keys | -f key_file] [-m cache_bytes] [-t threads] [-b batch_blocks] [-w wait_us]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+	if(nb_threads < 1)
+		nb_threads = parallel_default_threads();
+	
+	if(load_keys(key_file) != 0 || nb_keys == 0){
+		fprintf(stderr, "could not load the keys\n");
+		return EXIT_FAILURE;
+	}
+	if(cache_bytes == 0)
+		cache_bytes = (size_t)nb_keys * key_cache_entry_size();
+	cache = key_cache_new(cache_bytes, load_key, NULL);
+	
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_signal;     // no SA_RESTART: interrupts accept()
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+	
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+	unlink(socket_path);
+	if(server < 0 || bind(server, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server, 128) != 0){
+		perror(socket_path);
+		return EXIT_FAILURE;
+	}
+	
+	pthread_t batcher_thread;
+	spawn(&batcher_thread, batcher, NULL);
+	printf("aesd: NB_SHARES = %d, %u keys, %d threads, listening on %s\n", NB_SHARES, nb_keys, nb_threads, socket_path);
+	fflush(stdout);
+	
+	while(!stop){
+		int fd = accept(server, NULL, NULL);
+		if(fd < 0)
+			continue;
+		pthread_t thread;
+		if(spawn(&thread, connection, (void *)(intptr_t)fd) != 0)
+			close(fd);
+		else
+			pthread_detach(thread);
+	}
+	
+	pthread_mutex_lock(&lock);
+	pthread_cond_broadcast(&cond_pending);
+	pthread_mutex_unlock(&lock);
+	pthread_join(batcher_thread, NULL);
+	close(server);
+	unlink(socket_path);
+	
+	key_cache_stats stats;
+	key_cache_get_stats(cache, &stats);
+	printf("aesd: key cache %llu hits, %llu misses, %llu evictions, %zu entries (%zu / %zu bytes)\n",
+		(unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.evictions,
+		stats.entries, stats.bytes, stats.max_bytes);
+	printf("aesd: %llu requests, %llu blocks in %llu batches (average %.1f, max %llu blocks per batch)\n",
+		(unsigned long long)stat_requests, (unsigned long long)stat_blocks, (unsigned long long)stat_batches,
+		stat_batches ? (double)stat_blocks / stat_batches : 0.0, (unsigned long long)stat_max_batch);
+	return EXIT_SUCCESS;
+}
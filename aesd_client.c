@@ -0,0 +1,234 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "./aes_files/aes128_sharing.h"
+#include "./aes_files/aesd_protocol.h"
+
+/**********************************************************
+ * aesd_client : load generator for aesd.
+ * 
+ *    ./aesd_client [-s socket] [-c connections] 
+ *                  [-n requests] [-b blocks] [-k nb_keys]
+ *                  [-v]
+ * 
+ * Opens connections concurrent connections, and sends on
+ * each of them requests encryption requests of blocks 
+ * blocks under random keys among the nb_keys first ones,
+ * one request at a time. With -v, every result is 
+ * decrypted again and compared to the plaintext. Prints
+ * the throughput and the latency percentiles.
+**********************************************************/
+
+typedef struct {
+	int id;
+	double * latencies;
+	int nb_latencies;
+	int errors;
+} client_thread;
+
+static const char * socket_path = AESD_DEFAULT_SOCKET;
+static int nb_requests = 20;
+static uint32_t nb_blocks = 4;
+static uint32_t nb_keys = 16;
+static int verify = 0;
+
+
+static double now(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+static int read_full(int fd, void * buf, size_t len){
+	uint8_t * p = (uint8_t *)buf;
+	while(len > 0){
+		ssize_t n = read(fd, p, len);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return -1;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int write_full(int fd, const void * buf, size_t len){
+	const uint8_t * p = (const uint8_t *)buf;
+	while(len > 0){
+		ssize_t n = write(fd, p, len);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return -1;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+
+static int call(int fd, uint32_t op, uint32_t key_id, uint64_t tag, const uint8_t * in, uint8_t * out){
+	aesd_request req = { AESD_MAGIC, op, key_id, nb_blocks, tag };
+	aesd_response resp;
+	size_t len = (size_t)nb_blocks * AES_BLOCK_SIZE;
+	
+	if(write_full(fd, &req, sizeof(req)) != 0 || write_full(fd, in, len) != 0)
+		return -1;
+	if(read_full(fd, &resp, sizeof(resp)) != 0 || resp.magic != AESD_MAGIC || resp.tag != tag)
+		return -1;
+	if(resp.status != AESD_OK)
+		return resp.status;
+	return read_full(fd, out, len);
+}
+
+
+static void * run_client(void * arg){
+	client_thread * ct = (client_thread *)arg;
+	size_t len = (size_t)nb_blocks * AES_BLOCK_SIZE;
+	uint8_t * plain = (uint8_t *)malloc(len);
+	uint8_t * cipher = (uint8_t *)malloc(len);
+	uint8_t * res = (uint8_t *)malloc(len);
+	unsigned int seed = ct->id * 7919 + time(NULL);
+	
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+	if(fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0){
+		perror(socket_path);
+		ct->errors = nb_requests;
+		goto end;
+	}
+	
+	for(int r = 0; r < nb_requests; r++){
+		uint32_t key_id = rand_r(&seed) % nb_keys;
+		for(size_t i = 0; i < len; i++){
+			plain[i] = rand_r(&seed);
+		}
+		
+		double start = now();
+		if(call(fd, AESD_OP_ENCRYPT, key_id, r, plain, cipher) != 0){
+			ct->errors += nb_requests - r;
+			break;
+		}
+		ct->latencies[ct->nb_latencies++] = now() - start;
+		
+		if(verify && (call(fd, AESD_OP_DECRYPT, key_id, r, cipher, res) != 0 || memcmp(plain, res, len) != 0))
+			ct->errors++;
+	}
+	
+end:
+	if(fd >= 0)
+		close(fd);
+	free(plain);
+	free(cipher);
+	free(res);
+	return NULL;
+}
+
+
+static int cmp_double(const void * a, const void * b){
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+
+int main(int argc, char ** argv){
+	int nb_connections = 4;
+	int opt, c, errors = 0;
+	
+	while((opt = getopt(argc, argv, "s:c:n:b:k:v")) != -1){
+		switch(opt){
+			case 's': socket_path = optarg; break;
+			case 'c': nb_connections = atoi(optarg); break;
+			case 'n': nb_requests = atoi(optarg); break;
+			case 'b': nb_blocks = strtoul(optarg, NULL, 0); break;
+			case 'k': nb_keys = strtoul(optarg, NULL, 0); break;
+			case 'v': verify = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-s socket] [-c connections] [-n requests] [-b blocks] [-k nb_keys] [-v]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+	if(nb_connections < 1 || nb_requests < 1 || nb_blocks < 1 || nb_blocks > AESD_MAX_BLOCKS || nb_keys < 1){
+		fprintf(stderr, "invalid parameters\n");
+		return EXIT_FAILURE;
+	}
+	
+	client_thread * cts = (client_thread *)calloc(nb_connections, sizeof(client_thread));
+	pthread_t * threads = (pthread_t *)malloc(nb_connections * sizeof(pthread_t));
+	double * latencies = (double *)calloc((size_t)nb_connections * nb_requests, sizeof(double));
+	
+	double start = now();
+	for(c = 0; c < nb_connections; c++){
+		cts[c].id = c;
+		cts[c].latencies = latencies + (size_t)c * nb_requests;
+		pthread_create(&threads[c], NULL, run_client, &cts[c]);
+	}
+	for(c = 0; c < nb_connections; c++){
+		pthread_join(threads[c], NULL);
+	}
+	double elapsed = now() - start;
+	
+	// keep the latencies of the successful requests only
+	size_t total = 0;
+	for(c = 0; c < nb_connections; c++){
+		memmove(latencies + total, cts[c].latencies, cts[c].nb_latencies * sizeof(double));
+		total += cts[c].nb_latencies;
+		errors += cts[c].errors;
+	}
+	double bytes = (double)total * nb_blocks * AES_BLOCK_SIZE;
+	
+	printf("%d connections x %d requests of %u blocks, %d errors\n", nb_connections, nb_requests, nb_blocks, errors);
+	printf("throughput %.4f MB/s, %.1f requests/s\n", bytes / elapsed / 1.0e6, total / elapsed);
+	if(total == 0)
+		return EXIT_FAILURE;
+	qsort(latencies, total, sizeof(double), cmp_double);
+	printf("latency p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", latencies[total / 2] * 1000,
+		latencies[(size_t)(total * 0.99) < total ? (size_t)(total * 0.99) : total - 1] * 1000, latencies[total - 1] * 1000);
+	
+	free(latencies);
+	free(threads);
+	free(cts);
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,441 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "./aes_files/gadgets.h"
+#include "./aes_files/aes128.h"
+#include "./aes_files/aes128_sharing.h"
+#include "./aes_files/aes128_batch.h"
+#include "./aes_files/parallel.h"
+
+/**********************************************************
+ * aesfile : encrypts and decrypts files of any size with
+ * the n-share AES-128 in CTR mode.
+ * 
+ *    ./aesfile enc|dec -k key [-t threads] [-c chunk_bytes]
+ *              [-q depth] input output
+ * 
+ * key is given as 32 hexadecimal digits. The encrypted
+ * file starts with the magic AESFILE_MAGIC and the 
+ * random initial counter block, followed by the data 
+ * xored with the key stream (so decryption is the same
+ * operation).
+ * 
+ * The input is mmap'd (or read, when it cannot be 
+ * mapped, and until the end of file when it is not a 
+ * regular file, e.g. a pipe or /dev/stdin) and cut in
+ * chunks that go through three
+ * pipelined stages, connected by bounded queues of depth
+ * chunks:
+ *   - masking: generate_n_sharing_buffer of the data and of the
+ *     counter blocks,
+ *   - encryption: batch encryption of the counter blocks
+ *     over threads threads, and addition of the key 
+ *     stream to the data with add_gadget_function,
+ *   - unmasking: compress_n_sharing_buffer and write.
+**********************************************************/
+
+#define AESFILE_MAGIC      "NSAESCTR"
+#define AESFILE_MAGIC_LEN  8
+#define AESFILE_HEADER_LEN (AESFILE_MAGIC_LEN + AES_BLOCK_SIZE)
+#define CTR_MASK_BLOCKS    64         // counter blocks masked at once
+
+typedef struct {
+	size_t len;
+	uint64_t first_block;
+	const uint8_t * in;        // into the mapping, or read_buf
+	uint8_t * read_buf;
+	uint8_t * out;
+	uint8_t * data_sharing;
+	uint8_t * ctr_sharing;
+} file_chunk;
+
+typedef struct {
+	uint8_t ** roundkeys;
+	uint8_t iv[AES_BLOCK_SIZE];
+	int nb_threads;
+	size_t chunk_bytes;
+	int in_fd;
+	const uint8_t * map;
+	int stream;                // not a regular file, in_len is only known at the end
+	size_t in_len;
+	bounded_queue free_chunks;
+	bounded_queue masked;
+	bounded_queue encrypted;
+	double busy[3];
+	int error;
+} file_pipeline;
+
+
+static double now(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+static int read_full(int fd, uint8_t * buf, size_t len){
+	while(len > 0){
+		ssize_t n = read(fd, buf, len);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/**********************************************************
+ * Reads len bytes, or less at the end of file
+ * returns the number of bytes read, -1 on error
+**********************************************************/
+static ssize_t read_upto(int fd, uint8_t * buf, size_t len){
+	size_t done = 0;
+	while(done < len){
+		ssize_t n = read(fd, buf + done, len - done);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n < 0)
+			return -1;
+		if(n == 0)
+			break;
+		done += n;
+	}
+	return done;
+}
+
+static int write_full(int fd, const uint8_t * buf, size_t len){
+	while(len > 0){
+		ssize_t n = write(fd, buf, len);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+
+/**********************************************************
+ * ctr = iv + block (as 128-bit big endian integers)
+**********************************************************/
+static void counter_block(const uint8_t * iv, uint64_t block, uint8_t * ctr){
+	unsigned int carry = 0;
+	for(int i = AES_BLOCK_SIZE - 1; i >= 0; i--){
+		unsigned int v = iv[i] + (unsigned int)(block & 0xff) + carry;
+		ctr[i] = (uint8_t)v;
+		carry = v >> 8;
+		block >>= 8;
+	}
+}
+
+
+static void * mask_stage(void * arg){
+	file_pipeline * p = (file_pipeline *)arg;
+	uint8_t ctr[CTR_MASK_BLOCKS * AES_BLOCK_SIZE];
+	size_t offset = 0;
+	
+	while(p->stream || offset < p->in_len){
+		file_chunk * c = (file_chunk *)bounded_queue_pop(&p->free_chunks);
+		if(!c)
+			break;
+		double start = now();
+		
+		c->len = p->in_len - offset;
+		if(p->stream || c->len > p->chunk_bytes)
+			c->len = p->chunk_bytes;
+		c->first_block = offset / AES_BLOCK_SIZE;
+		if(p->map){
+			c->in = p->map + offset;
+		}
+		else if(p->stream){
+			// only the last chunk is shorter, so the chunks keep whole blocks
+			ssize_t n = read_upto(p->in_fd, c->read_buf, c->len);
+			if(n <= 0){
+				p->error = n < 0;
+				bounded_queue_push(&p->free_chunks, c);
+				break;
+			}
+			c->len = n;
+			c->in = c->read_buf;
+		}
+		else{
+			if(read_full(p->in_fd, c->read_buf, c->len) != 0){
+				p->error = 1;
+				break;
+			}
+			c->in = c->read_buf;
+		}
+		
+		generate_n_sharing_buffer(c->in, c->data_sharing, c->len);
+		size_t nb_blocks = (c->len + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+		for(size_t b = 0; b < nb_blocks; b += CTR_MASK_BLOCKS){
+			size_t nb = nb_blocks - b < CTR_MASK_BLOCKS ? nb_blocks - b : CTR_MASK_BLOCKS;
+			for(size_t j = 0; j < nb; j++){
+				counter_block(p->iv, c->first_block + b + j, ctr + j * AES_BLOCK_SIZE);
+			}
+			generate_n_sharing_buffer(ctr, c->ctr_sharing + b * AES_BLOCK_SHARING_SIZE, nb * AES_BLOCK_SIZE);
+		}
+		offset += c->len;
+		
+		p->busy[0] += now() - start;
+		if(bounded_queue_push(&p->masked, c) != 0)
+			break;
+	}
+	
+	if(p->stream)
+		p->in_len = offset;
+	bounded_queue_close(&p->masked);
+	return NULL;
+}
+
+
+static void * encrypt_stage(void * arg){
+	file_pipeline * p = (file_pipeline *)arg;
+	file_chunk * c;
+	
+	while((c = (file_chunk *)bounded_queue_pop(&p->masked)) != NULL){
+		double start = now();
+		
+		size_t nb_blocks = (c->len + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+		aes_encrypt_128_sharing_batch(p->roundkeys, c->ctr_sharing, c->ctr_sharing, nb_blocks, p->nb_threads);
+		for(size_t i = 0; i < c->len; i++){
+			add_gadget_function(c->data_sharing + i * NB_SHARES, c->ctr_sharing + i * NB_SHARES, c->data_sharing + i * NB_SHARES);
+		}
+		
+		p->busy[1] += now() - start;
+		if(bounded_queue_push(&p->encrypted, c) != 0)
+			break;
+	}
+	
+	bounded_queue_close(&p->encrypted);
+	return NULL;
+}
+
+
+/**********************************************************
+ * Last stage, run by the calling thread
+**********************************************************/
+static void unmask_stage(file_pipeline * p, int out_fd){
+	file_chunk * c;
+	
+	while((c = (file_chunk *)bounded_queue_pop(&p->encrypted)) != NULL){
+		double start = now();
+		
+		compress_n_sharing_buffer(c->data_sharing, c->out, c->len);
+		if(write_full(out_fd, c->out, c->len) != 0){
+			p->error = 1;
+			bounded_queue_close(&p->free_chunks);
+			bounded_queue_close(&p->masked);
+			bounded_queue_close(&p->encrypted);
+			break;
+		}
+		
+		p->busy[2] += now() - start;
+		bounded_queue_push(&p->free_chunks, c);
+	}
+}
+
+
+static int parse_key(const char * hex, uint8_t * key){
+	if(strlen(hex) != 2 * AES_BLOCK_SIZE)
+		return -1;
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		unsigned int v;
+		if(sscanf(hex + 2 * i, "%2x", &v) != 1)
+			return -1;
+		key[i] = v;
+	}
+	return 0;
+}
+
+
+static void usage(const char * name){
+	fprintf(stderr, "usage: %s enc|dec -k key [-t threads] [-c chunk_bytes] [-q depth] input output\n", name);
+}
+
+
+int main(int argc, char ** argv){
+	file_pipeline p;
+	uint8_t key[AES_BLOCK_SIZE], roundkeys[AES_ROUND_KEY_SIZE];
+	uint8_t header[AESFILE_HEADER_LEN];
+	const char * key_hex = NULL;
+	size_t depth = 4;
+	int opt, encrypt;
+	
+	memset(&p, 0, sizeof(p));
+	p.chunk_bytes = 64 * 1024;
+	
+	if(argc < 2 || (strcmp(argv[1], "enc") != 0 && strcmp(argv[1], "dec") != 0)){
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	encrypt = strcmp(argv[1], "enc") == 0;
+	optind = 2;
+	while((opt = getopt(argc, argv, "k:t:c:q:")) != -1){
+		switch(opt){
+			case 'k': key_hex = optarg; break;
+			case 't': p.nb_threads = atoi(optarg); break;
+			case 'c': p.chunk_bytes = strtoull(optarg, NULL, 0); break;
+			case 'q': depth = strtoull(optarg, NULL, 0); break;
+			default: usage(argv[0]); return EXIT_FAILURE;
+		}
+	}
+	if(optind + 2 != argc || !key_hex || parse_key(key_hex, key) != 0 || p.chunk_bytes == 0 || depth == 0){
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if(p.nb_threads < 1)
+		p.nb_threads = parallel_default_threads();
+	// keep whole blocks in every chunk, so that the counter of a chunk is its offset / AES_BLOCK_SIZE
+	p.chunk_bytes = (p.chunk_bytes + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE * AES_BLOCK_SIZE;
+	
+	int in_fd = open(argv[optind], O_RDONLY);
+	int out_fd = open(argv[optind + 1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(in_fd < 0 || out_fd < 0){
+		perror(in_fd < 0 ? argv[optind] : argv[optind + 1]);
+		return EXIT_FAILURE;
+	}
+	
+	if(encrypt){
+		FILE * f = fopen("/dev/urandom", "rb");
+		if(!f || fread(p.iv, 1, AES_BLOCK_SIZE, f) != AES_BLOCK_SIZE){
+			fprintf(stderr, "could not generate the initial counter block\n");
+			return EXIT_FAILURE;
+		}
+		fclose(f);
+		memcpy(header, AESFILE_MAGIC, AESFILE_MAGIC_LEN);
+		memcpy(header + AESFILE_MAGIC_LEN, p.iv, AES_BLOCK_SIZE);
+		if(write_full(out_fd, header, AESFILE_HEADER_LEN) != 0){
+			perror(argv[optind + 1]);
+			return EXIT_FAILURE;
+		}
+	}
+	else{
+		if(read_full(in_fd, header, AESFILE_HEADER_LEN) != 0 || memcmp(header, AESFILE_MAGIC, AESFILE_MAGIC_LEN) != 0){
+			fprintf(stderr, "%s: not an aesfile encrypted file\n", argv[optind]);
+			return EXIT_FAILURE;
+		}
+		memcpy(p.iv, header + AESFILE_MAGIC_LEN, AES_BLOCK_SIZE);
+	}
+	
+	// map the input, or fall back to reading it (until the end of file when it is not a regular file)
+	struct stat st;
+	off_t data_offset = encrypt ? 0 : AESFILE_HEADER_LEN;
+	uint8_t * map = NULL;
+	size_t map_len = 0;
+	p.in_fd = in_fd;
+	if(fstat(in_fd, &st) == 0 && S_ISREG(st.st_mode)){
+		p.in_len = st.st_size - data_offset;
+		map_len = st.st_size;
+		if(map_len > 0){
+			map = (uint8_t *)mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, in_fd, 0);
+			if(map == MAP_FAILED)
+				map = NULL;
+			else{
+				madvise(map, map_len, MADV_SEQUENTIAL);
+				p.map = map + data_offset;
+			}
+		}
+	}
+	else
+		p.stream = 1;
+	
+	aes_key_expansion_128(key, roundkeys);
+	p.roundkeys = generate_roundkeys_sharing(roundkeys);
+	memset(key, 0, sizeof(key));
+	memset(roundkeys, 0, sizeof(roundkeys));
+	
+	// depth chunks in each queue, plus one per stage
+	size_t nb_chunks = 2 * depth + 3;
+	file_chunk * chunks = (file_chunk *)calloc(nb_chunks, sizeof(file_chunk));
+	bounded_queue_init(&p.free_chunks, nb_chunks);
+	bounded_queue_init(&p.masked, depth);
+	bounded_queue_init(&p.encrypted, depth);
+	for(size_t i = 0; i < nb_chunks; i++){
+		chunks[i].read_buf = p.map ? NULL : (uint8_t *)malloc(p.chunk_bytes);
+		chunks[i].out = (uint8_t *)malloc(p.chunk_bytes);
+		chunks[i].data_sharing = (uint8_t *)malloc(p.chunk_bytes * NB_SHARES);
+		chunks[i].ctr_sharing = (uint8_t *)malloc(p.chunk_bytes * NB_SHARES);
+		if(!chunks[i].out || !chunks[i].data_sharing || !chunks[i].ctr_sharing){
+			fprintf(stderr, "out of memory\n");
+			return EXIT_FAILURE;
+		}
+		bounded_queue_push(&p.free_chunks, &chunks[i]);
+	}
+	
+	double start = now();
+	pthread_t mask_thread, encrypt_thread;
+	pthread_create(&mask_thread, NULL, mask_stage, &p);
+	pthread_create(&encrypt_thread, NULL, encrypt_stage, &p);
+	unmask_stage(&p, out_fd);
+	pthread_join(mask_thread, NULL);
+	pthread_join(encrypt_thread, NULL);
+	double elapsed = now() - start;
+	
+	if(p.error)
+		fprintf(stderr, "I/O error\n");
+	else
+		fprintf(stderr, "%s %zu bytes in %.3f s: %.4f MB/s (NB_SHARES = %d, %d threads), "
+			"stage busy: mask %.0f%%, encrypt %.0f%%, unmask %.0f%%\n", encrypt ? "encrypted" : "decrypted",
+			p.in_len, elapsed, p.in_len / elapsed / 1.0e6, NB_SHARES, p.nb_threads,
+			100 * p.busy[0] / elapsed, 100 * p.busy[1] / elapsed, 100 * p.busy[2] / elapsed);
+	
+	for(size_t i = 0; i < nb_chunks; i++){
+		free(chunks[i].read_buf);
+		free(chunks[i].out);
+		free(chunks[i].data_sharing);
+		free(chunks[i].ctr_sharing);
+	}
+	free(chunks);
+	bounded_queue_destroy(&p.free_chunks);
+	bounded_queue_destroy(&p.masked);
+	bounded_queue_destroy(&p.encrypted);
+	free_roundkeys_sharing(p.roundkeys);
+	if(map)
+		munmap(map, map_len);
+	close(in_fd);
+	close(out_fd);
+	return p.error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,1488 @@
+/***************************************************************************
+ * Implementation of Protected n-share AES-128 in C
+ * 
+ * This code is an implementation of a protected n-share AES-128 using 
+ * compiled gadgets with the expanding circuit compiler introduced in:
+ * 
+ * "Random Probing Security: Verification, Composition, Expansion and New 
+ * Constructions"
+ * By Sonia Belaïd, Jean-Sébastien Coron, Emmanuel Prouff, Matthieu Rivain, 
+ * and Abdul Rahman Taleb
+ * In the proceedings of CRYPTO 2020.
+ * 
+ * Copyright (C) 2020 CryptoExperts
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+***************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include "./aes_files/gf256.h"
+#include "./aes_files/gadgets.h"
+#include "./aes_files/aes128.h"
+#include "./aes_files/aes128_sharing.h"
+#include "./aes_files/aes128_batch.h"
+#include "./aes_files/aes128_pipeline.h"
+#include "./aes_files/aes128_team.h"
+#include "./aes_files/aes128_cbc_sharing.h"
+#include "./aes_files/aes128_cmac_sharing.h"
+#include "./aes_files/aes128_xts_sharing.h"
+#include "./aes_files/key_cache.h"
+#include "./aes_files/keystore.h"
+#include "./aes_files/perf_trace.h"
+#include "./aes_files/rand_ring.h"
+#include "./aes_files/sbox_table_sharing.h"
+#include "./aes_files/parallel.h"
+
+/**********************************************************
+ * Benchmarks of the bulk n-share AES-128 interfaces.
+ * 
+ *    ./bench <name> [options]
+ * 
+ * Each benchmark masks its input with 
+ * generate_n_sharing_buffer,
+ * runs the n-share computation, checks the result after
+ * compress_n_sharing_buffer and prints the throughput.
+**********************************************************/
+
+double my_gettimeofday(){
+  struct timeval tmp_time;
+  gettimeofday(&tmp_time, NULL);
+  return tmp_time.tv_sec + (tmp_time.tv_usec * 1.0e-6L);
+}
+
+
+/**********************************************************
+ * n-share round keys of random round keys
+**********************************************************/
+static uint8_t ** new_roundkeys_sharing(){
+	uint8_t roundkeys[AES_ROUND_KEY_SIZE];
+	for(int i = 0; i < AES_ROUND_KEY_SIZE; i++){
+		roundkeys[i] = rand();
+	}
+	return generate_roundkeys_sharing(roundkeys);
+}
+
+
+/**********************************************************
+ * n-share round keys of the AES-128 key key
+**********************************************************/
+static uint8_t ** key_roundkeys_sharing(const uint8_t * key){
+	uint8_t roundkeys[AES_ROUND_KEY_SIZE];
+	aes_key_expansion_128(key, roundkeys);
+	return generate_roundkeys_sharing(roundkeys);
+}
+
+
+static uint8_t * random_buffer(size_t len){
+	uint8_t * buf = (uint8_t *)malloc(len);
+	for(size_t i = 0; i < len; i++){
+		buf[i] = rand();
+	}
+	return buf;
+}
+
+static void print_result(const char * name, int nb_threads, size_t bytes, double seconds, int ok){
+	printf("%-28s threads=%-3d %10zu bytes %10.3f ms %10.4f MB/s  %s\n", name, nb_threads, bytes,
+		seconds * 1000, bytes / seconds / 1.0e6, ok ? "OK" : "ERROR");
+}
+
+
+/*************************** CBC ***************************/
+/* unmasked CBC encryption, to check the n-share one */
+static void cbc_encrypt_reference(const uint8_t * roundkeys, const uint8_t * iv, const uint8_t * in, uint8_t * out, size_t nb_blocks){
+	const uint8_t * prev = iv;
+	uint8_t x[AES_BLOCK_SIZE];
+	for(size_t b = 0; b < nb_blocks; b++){
+		for(int i = 0; i < AES_BLOCK_SIZE; i++){
+			x[i] = in[b * AES_BLOCK_SIZE + i] ^ prev[i];
+		}
+		aes_encrypt_128(roundkeys, x, out + b * AES_BLOCK_SIZE);
+		prev = out + b * AES_BLOCK_SIZE;
+	}
+}
+
+
+/* NIST SP 800-38A, F.2.1 and F.2.2 (CBC-AES128) */
+static int check_cbc_vector(){
+	static const uint8_t key[AES_BLOCK_SIZE] = {
+		0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+	static const uint8_t iv[AES_BLOCK_SIZE] = {
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+	static const uint8_t plain[4 * AES_BLOCK_SIZE] = {
+		0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+		0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+		0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+		0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10 };
+	static const uint8_t cipher[4 * AES_BLOCK_SIZE] = {
+		0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46, 0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+		0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee, 0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+		0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b, 0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+		0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09, 0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7 };
+	uint8_t res[4 * AES_BLOCK_SIZE];
+	uint8_t * data_sharing = (uint8_t *)malloc(sizeof(plain) * NB_SHARES);
+	uint8_t ** roundkeys = key_roundkeys_sharing(key);
+	int ok;
+	
+	generate_n_sharing_buffer(plain, data_sharing, sizeof(plain));
+	aes_cbc_encrypt_128_sharing(roundkeys, iv, data_sharing, data_sharing, 4);
+	compress_n_sharing_buffer(data_sharing, res, sizeof(res));
+	ok = memcmp(res, cipher, sizeof(cipher)) == 0;
+	
+	generate_n_sharing_buffer(cipher, data_sharing, sizeof(cipher));
+	aes_cbc_decrypt_128_sharing(roundkeys, iv, data_sharing, data_sharing, 4, 1);
+	compress_n_sharing_buffer(data_sharing, res, sizeof(res));
+	ok &= memcmp(res, plain, sizeof(plain)) == 0;
+	
+	printf("NIST SP 800-38A CBC-AES128 vectors : %s\n", ok ? "OK" : "ERROR");
+	free(data_sharing);
+	free_roundkeys_sharing(roundkeys);
+	return ok;
+}
+
+
+/* ./bench cbc [bytes] [max_threads] [messages] */
+static int bench_cbc(int argc, char ** argv){
+	size_t bytes = argc > 0 ? strtoull(argv[0], NULL, 0) : 16384;
+	int max_threads = argc > 1 ? atoi(argv[1]) : parallel_default_threads();
+	size_t nb_msgs = argc > 2 ? strtoull(argv[2], NULL, 0) : 16;
+	size_t nb_blocks = (bytes + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+	bytes = nb_blocks * AES_BLOCK_SIZE;
+	int ok, failures = 0;
+	double start, elapsed;
+	
+	printf("CBC, NB_SHARES = %d\n", NB_SHARES);
+	failures += !check_cbc_vector();
+	
+	uint8_t key[AES_BLOCK_SIZE], roundkeys_ref[AES_ROUND_KEY_SIZE];
+	uint8_t iv[AES_BLOCK_SIZE];
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		key[i] = rand();
+		iv[i] = rand();
+	}
+	aes_key_expansion_128(key, roundkeys_ref);
+	uint8_t ** roundkeys = generate_roundkeys_sharing(roundkeys_ref);
+	uint8_t * plain = random_buffer(bytes);
+	uint8_t * ref = (uint8_t *)malloc(bytes);
+	uint8_t * res = (uint8_t *)malloc(bytes);
+	uint8_t * plain_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	uint8_t * cipher_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	uint8_t * res_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	generate_n_sharing_buffer(plain, plain_sharing, bytes);
+	
+	start = my_gettimeofday();
+	aes_cbc_encrypt_128_sharing(roundkeys, iv, plain_sharing, cipher_sharing, nb_blocks);
+	elapsed = my_gettimeofday() - start;
+	cbc_encrypt_reference(roundkeys_ref, iv, plain, ref, nb_blocks);
+	compress_n_sharing_buffer(cipher_sharing, res, bytes);
+	ok = memcmp(ref, res, bytes) == 0;
+	failures += !ok;
+	print_result("cbc encrypt", 1, bytes, elapsed, ok);
+	
+	for(int t = 1; t <= max_threads; t *= 2){
+		start = my_gettimeofday();
+		aes_cbc_decrypt_128_sharing(roundkeys, iv, cipher_sharing, res_sharing, nb_blocks, t);
+		elapsed = my_gettimeofday() - start;
+		compress_n_sharing_buffer(res_sharing, res, bytes);
+		ok = memcmp(plain, res, bytes) == 0;
+		failures += !ok;
+		print_result("cbc decrypt", t, bytes, elapsed, ok);
+	}
+	
+	// the same total amount of data, split in independent messages
+	if(nb_msgs > nb_blocks)
+		nb_msgs = nb_blocks;
+	cbc_message_sharing * msgs = (cbc_message_sharing *)malloc(nb_msgs * sizeof(cbc_message_sharing));
+	size_t offset = 0;
+	for(size_t m = 0; m < nb_msgs; m++){
+		msgs[m].iv = iv;
+		msgs[m].nb_blocks = nb_blocks / nb_msgs + (m < nb_blocks % nb_msgs ? 1 : 0);
+		msgs[m].in = plain_sharing + offset * AES_BLOCK_SHARING_SIZE;
+		msgs[m].out = cipher_sharing + offset * AES_BLOCK_SHARING_SIZE;
+		cbc_encrypt_reference(roundkeys_ref, iv, plain + offset * AES_BLOCK_SIZE, ref + offset * AES_BLOCK_SIZE, msgs[m].nb_blocks);
+		offset += msgs[m].nb_blocks;
+	}
+	for(int t = 1; t <= max_threads; t *= 2){
+		start = my_gettimeofday();
+		aes_cbc_encrypt_128_sharing_multi(roundkeys, msgs, nb_msgs, t);
+		elapsed = my_gettimeofday() - start;
+		compress_n_sharing_buffer(cipher_sharing, res, bytes);
+		ok = memcmp(ref, res, bytes) == 0;
+		failures += !ok;
+		print_result("cbc encrypt multi-message", t, bytes, elapsed, ok);
+	}
+	
+	free(msgs);
+	free(plain);
+	free(ref);
+	free(res);
+	free(plain_sharing);
+	free(cipher_sharing);
+	free(res_sharing);
+	free_roundkeys_sharing(roundkeys);
+	return failures;
+}
+
+
+/*************************** XTS ***************************/
+/* IEEE 1619-2007, vectors 1 to 3 (one 32 byte data unit) */
+static int check_xts_vectors(){
+	static const uint8_t key1[3][AES_BLOCK_SIZE] = {
+		{ 0 },
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11 },
+		{ 0xff, 0xfe, 0xfd, 0xfc, 0xfb, 0xfa, 0xf9, 0xf8, 0xf7, 0xf6, 0xf5, 0xf4, 0xf3, 0xf2, 0xf1, 0xf0 } };
+	static const uint8_t key2[3][AES_BLOCK_SIZE] = {
+		{ 0 },
+		{ 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22 },
+		{ 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22 } };
+	static const uint64_t sector[3] = { 0, 0x3333333333ULL, 0x3333333333ULL };
+	static const uint8_t plain_byte[3] = { 0x00, 0x44, 0x44 };
+	static const uint8_t cipher[3][2 * AES_BLOCK_SIZE] = {
+		{ 0x91, 0x7c, 0xf6, 0x9e, 0xbd, 0x68, 0xb2, 0xec, 0x9b, 0x9f, 0xe9, 0xa3, 0xea, 0xdd, 0xa6, 0x92,
+		  0xcd, 0x43, 0xd2, 0xf5, 0x95, 0x98, 0xed, 0x85, 0x8c, 0x02, 0xc2, 0x65, 0x2f, 0xbf, 0x92, 0x2e },
+		{ 0xc4, 0x54, 0x18, 0x5e, 0x6a, 0x16, 0x93, 0x6e, 0x39, 0x33, 0x40, 0x38, 0xac, 0xef, 0x83, 0x8b,
+		  0xfb, 0x18, 0x6f, 0xff, 0x74, 0x80, 0xad, 0xc4, 0x28, 0x93, 0x82, 0xec, 0xd6, 0xd3, 0x94, 0xf0 },
+		{ 0xaf, 0x85, 0x33, 0x6b, 0x59, 0x7a, 0xfc, 0x1a, 0x90, 0x0b, 0x2e, 0xb2, 0x1e, 0xc9, 0x49, 0xd2,
+		  0x92, 0xdf, 0x4c, 0x04, 0x7e, 0x0b, 0x21, 0x53, 0x21, 0x86, 0xa5, 0x97, 0x1a, 0x22, 0x7a, 0x89 } };
+	uint8_t plain[2 * AES_BLOCK_SIZE], res[2 * AES_BLOCK_SIZE];
+	uint8_t * data_sharing = (uint8_t *)malloc(sizeof(plain) * NB_SHARES);
+	int ok = 1;
+	
+	for(int v = 0; v < 3; v++){
+		uint8_t ** roundkeys1 = key_roundkeys_sharing(key1[v]);
+		uint8_t ** roundkeys2 = key_roundkeys_sharing(key2[v]);
+		memset(plain, plain_byte[v], sizeof(plain));
+		
+		generate_n_sharing_buffer(plain, data_sharing, sizeof(plain));
+		aes_xts_encrypt_128_sharing(roundkeys1, roundkeys2, sector[v], data_sharing, data_sharing, sizeof(plain), 1, 1);
+		compress_n_sharing_buffer(data_sharing, res, sizeof(res));
+		ok &= memcmp(res, cipher[v], sizeof(res)) == 0;
+		
+		generate_n_sharing_buffer(cipher[v], data_sharing, sizeof(plain));
+		aes_xts_decrypt_128_sharing(roundkeys1, roundkeys2, sector[v], data_sharing, data_sharing, sizeof(plain), 1, 1);
+		compress_n_sharing_buffer(data_sharing, res, sizeof(res));
+		ok &= memcmp(res, plain, sizeof(res)) == 0;
+		
+		free_roundkeys_sharing(roundkeys1);
+		free_roundkeys_sharing(roundkeys2);
+	}
+	
+	printf("IEEE 1619 XTS-AES128 vectors : %s\n", ok ? "OK" : "ERROR");
+	free(data_sharing);
+	return ok;
+}
+
+
+/* ./bench xts [sector_size] [nb_sectors] [max_threads] */
+static int bench_xts(int argc, char ** argv){
+	size_t sector_size = argc > 0 ? strtoull(argv[0], NULL, 0) : 512;
+	size_t nb_sectors = argc > 1 ? strtoull(argv[1], NULL, 0) : 8;
+	int max_threads = argc > 2 ? atoi(argv[2]) : parallel_default_threads();
+	size_t bytes = sector_size * nb_sectors;
+	int ok, failures = 0;
+	double start, enc, dec;
+	
+	uint8_t ** roundkeys1 = new_roundkeys_sharing();
+	uint8_t ** roundkeys2 = new_roundkeys_sharing();
+	uint8_t * plain = random_buffer(bytes);
+	uint8_t * res = (uint8_t *)malloc(bytes);
+	uint8_t * plain_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	uint8_t * data_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	generate_n_sharing_buffer(plain, plain_sharing, bytes);
+	
+	printf("XTS, NB_SHARES = %d, %zu sectors of %zu bytes\n", NB_SHARES, nb_sectors, sector_size);
+	failures += !check_xts_vectors();
+	
+	for(int t = 1; t <= max_threads; t *= 2){
+		start = my_gettimeofday();
+		if(aes_xts_encrypt_128_sharing(roundkeys1, roundkeys2, 0, plain_sharing, data_sharing, sector_size, nb_sectors, t) != 0){
+			printf("invalid sector size %zu\n", sector_size);
+			failures++;
+			break;
+		}
+		enc = my_gettimeofday() - start;
+		
+		start = my_gettimeofday();
+		aes_xts_decrypt_128_sharing(roundkeys1, roundkeys2, 0, data_sharing, data_sharing, sector_size, nb_sectors, t);
+		dec = my_gettimeofday() - start;
+		
+		compress_n_sharing_buffer(data_sharing, res, bytes);
+		ok = memcmp(plain, res, bytes) == 0;
+		failures += !ok;
+		print_result("xts encrypt", t, bytes, enc, ok);
+		print_result("xts decrypt", t, bytes, dec, ok);
+	}
+	
+	free(plain);
+	free(res);
+	free(plain_sharing);
+	free(data_sharing);
+	free_roundkeys_sharing(roundkeys1);
+	free_roundkeys_sharing(roundkeys2);
+	return failures;
+}
+
+
+/*************************** Key cache ***************************/
+static int bench_key_loader(void * ctx, uint64_t handle, uint8_t * key){
+	(void)ctx;
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		key[i] = (uint8_t)(handle >> (8 * (i % 8))) ^ (uint8_t)(i * 0x9d);
+	}
+	return 0;
+}
+
+typedef struct {
+	key_cache * cache;
+	size_t nb_handles;
+	size_t lookups;
+	int failures;
+} key_cache_job;
+
+static void key_cache_worker(void * arg, size_t begin, size_t end){
+	key_cache_job * job = (key_cache_job *)arg;
+	unsigned int seed = begin * 31 + 7;
+	for(size_t t = begin; t < end; t++){
+		for(size_t l = 0; l < job->lookups; l++){
+			// 80% of the lookups go to the first 20% of the handles
+			size_t hot = job->nb_handles / 5 ? job->nb_handles / 5 : 1;
+			uint64_t handle = rand_r(&seed) % 5 ? rand_r(&seed) % hot : rand_r(&seed) % job->nb_handles;
+			uint8_t ** roundkeys = key_cache_acquire(job->cache, handle);
+			if(!roundkeys){
+				__atomic_fetch_add(&job->failures, 1, __ATOMIC_RELAXED);
+				continue;
+			}
+			key_cache_release(job->cache, roundkeys);
+		}
+	}
+}
+
+/* ./bench keycache [nb_handles] [cache_entries] [lookups_per_thread] [max_threads] */
+static int bench_keycache(int argc, char ** argv){
+	size_t nb_handles = argc > 0 ? strtoull(argv[0], NULL, 0) : 50000;
+	size_t cache_entries = argc > 1 ? strtoull(argv[1], NULL, 0) : 10000;
+	size_t lookups = argc > 2 ? strtoull(argv[2], NULL, 0) : 200000;
+	int max_threads = argc > 3 ? atoi(argv[3]) : parallel_default_threads();
+	int failures = 0;
+	double start, elapsed;
+	key_cache_stats stats;
+	
+	printf("Key cache, NB_SHARES = %d, %zu handles, %zu entries of %zu bytes\n", NB_SHARES, nb_handles,
+		cache_entries, key_cache_entry_size());
+	
+	// reference: expanding and sharing the key for every request
+	uint8_t key[AES_BLOCK_SIZE], roundkeys[AES_ROUND_KEY_SIZE];
+	size_t nb_expand = lookups < 10000 ? lookups : 10000;
+	start = my_gettimeofday();
+	for(size_t l = 0; l < nb_expand; l++){
+		bench_key_loader(NULL, l, key);
+		aes_key_expansion_128(key, roundkeys);
+		uint8_t ** roundkeys_sharing = generate_roundkeys_sharing(roundkeys);
+		free_roundkeys_sharing(roundkeys_sharing);
+	}
+	elapsed = my_gettimeofday() - start;
+	printf("%-28s %10.3f us per request\n", "expand + share per request", elapsed / nb_expand * 1.0e6);
+	
+	for(int t = 1; t <= max_threads; t *= 2){
+		key_cache_job job = { key_cache_new(cache_entries * key_cache_entry_size(), bench_key_loader, NULL), nb_handles, lookups, 0 };
+		start = my_gettimeofday();
+		run_parallel(key_cache_worker, &job, t, t);
+		elapsed = my_gettimeofday() - start;
+		key_cache_get_stats(job.cache, &stats);
+		printf("%-28s threads=%-3d %10.3f us per lookup, hits %llu, misses %llu, evictions %llu, %zu bytes  %s\n",
+			"key cache acquire/release", t, elapsed / (lookups * t) * 1.0e6, (unsigned long long)stats.hits,
+			(unsigned long long)stats.misses, (unsigned long long)stats.evictions, stats.bytes,
+			job.failures == 0 && stats.bytes <= stats.max_bytes ? "OK" : "ERROR");
+		failures += job.failures != 0 || stats.bytes > stats.max_bytes;
+		key_cache_free(job.cache);
+	}
+	
+	return failures;
+}
+
+
+/*************************** Performance counters ***************************/
+/* ./bench perf [nb_blocks] [csv_file] */
+static int bench_perf(int argc, char ** argv){
+#ifndef PERF_TRACE
+	printf("built without PERF_TRACE, rebuild with make FLAGS=\"-O0 -DPERF_TRACE\"\n");
+	return 1;
+#endif
+	size_t nb_blocks = argc > 0 ? strtoull(argv[0], NULL, 0) : 16;
+	FILE * f = argc > 1 ? fopen(argv[1], "w") : stdout;
+	
+	if(!f){
+		perror(argv[1]);
+		return 1;
+	}
+	
+	uint8_t ** roundkeys = new_roundkeys_sharing();
+	uint8_t * plain = random_buffer(nb_blocks * AES_BLOCK_SIZE);
+	uint8_t * data_sharing = (uint8_t *)malloc(nb_blocks * AES_BLOCK_SHARING_SIZE);
+	generate_n_sharing_buffer(plain, data_sharing, nb_blocks * AES_BLOCK_SIZE);
+	
+	perf_trace_reset();
+	aes_encrypt_128_sharing_batch(roundkeys, data_sharing, data_sharing, nb_blocks, 1);
+	perf_trace_dump_csv(f);
+	
+	if(f != stdout)
+		fclose(f);
+	free(plain);
+	free(data_sharing);
+	free_roundkeys_sharing(roundkeys);
+	return 0;
+}
+
+
+/*************************** Masking ***************************/
+/* ./bench mask [bytes] */
+static int bench_mask(int argc, char ** argv){
+	size_t bytes = argc > 0 ? strtoull(argv[0], NULL, 0) : 1 << 20;
+	int ok, failures = 0;
+	double start, t;
+	
+	uint8_t * plain = random_buffer(bytes);
+	uint8_t * res = (uint8_t *)malloc(bytes);
+	uint8_t * data_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	
+	printf("masking, NB_SHARES = %d\n", NB_SHARES);
+	
+	start = my_gettimeofday();
+	for(size_t i = 0; i < bytes; i++){
+		generate_n_sharing(plain[i], data_sharing + i * NB_SHARES);
+	}
+	t = my_gettimeofday() - start;
+	print_result("generate_n_sharing", 1, bytes, t, 1);
+	
+	start = my_gettimeofday();
+	for(size_t i = 0; i < bytes; i++){
+		res[i] = compress_n_sharing(data_sharing + i * NB_SHARES);
+	}
+	t = my_gettimeofday() - start;
+	ok = memcmp(plain, res, bytes) == 0;
+	failures += !ok;
+	print_result("compress_n_sharing", 1, bytes, t, ok);
+	
+	start = my_gettimeofday();
+	generate_n_sharing_buffer(plain, data_sharing, bytes);
+	t = my_gettimeofday() - start;
+	print_result("generate_n_sharing_buffer", 1, bytes, t, 1);
+	
+	memset(res, 0, bytes);
+	start = my_gettimeofday();
+	compress_n_sharing_buffer(data_sharing, res, bytes);
+	t = my_gettimeofday() - start;
+	ok = memcmp(plain, res, bytes) == 0;
+	failures += !ok;
+	print_result("compress_n_sharing_buffer", 1, bytes, t, ok);
+	
+	free(plain);
+	free(res);
+	free(data_sharing);
+	return failures;
+}
+
+
+/*************************** S-box ***************************/
+typedef void (*sbox_fn)(uint8_t * x, uint8_t * out);
+
+static int run_sbox(const char * name, sbox_fn fn, int inverse, size_t nb){
+	uint8_t x[NB_SHARES], y[NB_SHARES];
+	int ok = 1;
+	double start, t;
+	
+	for(int v = 0; v < 256; v++){
+		generate_n_sharing(v, x);
+		fn(x, y);
+		uint8_t s = compress_n_sharing(y);
+		ok &= inverse ? aes_sbox(s) == v : s == aes_sbox(v);
+	}
+	
+	start = my_gettimeofday();
+	for(size_t i = 0; i < nb; i++){
+		generate_n_sharing(i, x);
+		fn(x, x);
+	}
+	t = my_gettimeofday() - start;
+	printf("%-28s %10zu S-boxes %10.3f ms %10.3f us/S-box  %s\n", name, nb, t * 1000, t / nb * 1.0e6, ok ? "OK" : "ERROR");
+	return !ok;
+}
+
+/* ./bench sbox [nb] */
+static int bench_sbox(int argc, char ** argv){
+	size_t nb = argc > 0 ? strtoull(argv[0], NULL, 0) : 10000;
+	int failures = 0;
+	
+	printf("S-box, NB_SHARES = %d, SBOX_TABLE_MAX_SHARES = %d (%s selected)\n", NB_SHARES, SBOX_TABLE_MAX_SHARES,
+		NB_SHARES <= SBOX_TABLE_MAX_SHARES ? "table" : "polynomial");
+	failures += run_sbox("sbox polynomial", get_sbox_value_sharing_poly, 0, nb);
+	failures += run_sbox("sbox table", get_sbox_value_sharing_table, 0, nb);
+	failures += run_sbox("inverse sbox polynomial", get_inv_sbox_value_sharing_poly, 1, nb);
+	failures += run_sbox("inverse sbox table", get_inv_sbox_value_sharing_table, 1, nb);
+	return failures;
+}
+
+
+/*************************** Gadgets ***************************/
+/* ./bench gadgets [nb_calls] [nb_blocks] */
+static int bench_gadgets(int argc, char ** argv){
+	size_t nb = argc > 0 ? strtoull(argv[0], NULL, 0) : 1000000;
+	size_t nb_blocks = argc > 1 ? strtoull(argv[1], NULL, 0) : 64;
+	uint8_t a[NB_SHARES], b[NB_SHARES], c[NB_SHARES], d[NB_SHARES];
+	int ok, failures = 0;
+	double start, t;
+	size_t i;
+	
+#ifdef GADGETS_FAST_PATH
+	printf("gadgets, NB_SHARES = %d, inline fast path\n", NB_SHARES);
+#else
+	printf("gadgets, NB_SHARES = %d, generic gadgets\n", NB_SHARES);
+#endif
+	generate_n_sharing(0x53, a);
+	generate_n_sharing(0xca, b);
+	
+	start = my_gettimeofday();
+	for(i = 0; i < nb; i++){
+		add_gadget_function(a, b, c);
+		add_gadget_function(c, b, a);
+	}
+	t = my_gettimeofday() - start;
+	ok = compress_n_sharing(a) == 0x53;
+	failures += !ok;
+	printf("%-28s %10.3f ns/call  %s\n", "add", t / (2 * nb) * 1.0e9, ok ? "OK" : "ERROR");
+	
+	start = my_gettimeofday();
+	for(i = 0; i < nb; i++){
+		copy_gadget_function(a, c, d);
+		copy_gadget_function(d, a, c);
+	}
+	t = my_gettimeofday() - start;
+	ok = compress_n_sharing(a) == 0x53 && compress_n_sharing(c) == 0x53;
+	failures += !ok;
+	printf("%-28s %10.3f ns/call  %s\n", "copy", t / (2 * nb) * 1.0e9, ok ? "OK" : "ERROR");
+	
+	start = my_gettimeofday();
+	for(i = 0; i < nb; i++){
+		mult_gadget_function(a, b, c);
+	}
+	t = my_gettimeofday() - start;
+	ok = compress_n_sharing(c) == Multiply(0x53, 0xca);
+	failures += !ok;
+	printf("%-28s %10.3f ns/call  %s\n", "mult", t / nb * 1.0e9, ok ? "OK" : "ERROR");
+	
+	start = my_gettimeofday();
+	for(i = 0; i < nb; i++){
+		add_cons_gadget_function(0x63, a, c);
+		add_cons_gadget_function(0x63, c, a);
+	}
+	t = my_gettimeofday() - start;
+	ok = compress_n_sharing(a) == 0x53;
+	failures += !ok;
+	printf("%-28s %10.3f ns/call  %s\n", "add_cons", t / (2 * nb) * 1.0e9, ok ? "OK" : "ERROR");
+	
+	start = my_gettimeofday();
+	for(i = 0; i < nb; i++){
+		mult_cons_gadget_function(0x03, a, c);
+		mult_cons_gadget_function(0xf6, c, a);
+	}
+	t = my_gettimeofday() - start;
+	ok = compress_n_sharing(a) == 0x53;    // 0x03 * 0xf6 = 1
+	failures += !ok;
+	printf("%-28s %10.3f ns/call  %s\n", "mult_cons", t / (2 * nb) * 1.0e9, ok ? "OK" : "ERROR");
+	
+	size_t bytes = nb_blocks * AES_BLOCK_SIZE;
+	uint8_t ** roundkeys = new_roundkeys_sharing();
+	uint8_t * plain = random_buffer(bytes);
+	uint8_t * res = (uint8_t *)malloc(bytes);
+	uint8_t * data_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	generate_n_sharing_buffer(plain, data_sharing, bytes);
+	
+	start = my_gettimeofday();
+	aes_encrypt_128_sharing_batch(roundkeys, data_sharing, data_sharing, nb_blocks, 1);
+	t = my_gettimeofday() - start;
+	aes_decrypt_128_sharing_batch(roundkeys, data_sharing, data_sharing, nb_blocks, 1);
+	compress_n_sharing_buffer(data_sharing, res, bytes);
+	ok = memcmp(plain, res, bytes) == 0;
+	failures += !ok;
+	print_result("encrypt", 1, bytes, t, ok);
+	
+	free(plain);
+	free(res);
+	free(data_sharing);
+	free_roundkeys_sharing(roundkeys);
+	return failures;
+}
+
+
+/*************************** Pipeline ***************************/
+/* ./bench pipeline [nb_blocks] [max_stages] */
+static int bench_pipeline(int argc, char ** argv){
+	size_t nb_blocks = argc > 0 ? strtoull(argv[0], NULL, 0) : 256;
+	int max_stages = argc > 1 ? atoi(argv[1]) : AES_ROUNDS;
+	size_t bytes = nb_blocks * AES_BLOCK_SIZE;
+	int ok, failures = 0;
+	double start, t;
+	
+	uint8_t ** roundkeys = new_roundkeys_sharing();
+	uint8_t * plain = random_buffer(bytes);
+	uint8_t * res = (uint8_t *)malloc(bytes);
+	uint8_t * plain_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	uint8_t * data_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	generate_n_sharing_buffer(plain, plain_sharing, bytes);
+	
+	printf("round pipeline against batching, NB_SHARES = %d, %zu blocks\n", NB_SHARES, nb_blocks);
+	
+	// 1, 2, 4, 8 and AES_ROUNDS stages
+	for(int s = 1; s <= max_stages && s <= AES_ROUNDS; s = (s < AES_ROUNDS && s * 2 > AES_ROUNDS) ? AES_ROUNDS : s * 2){
+		start = my_gettimeofday();
+		aes_encrypt_128_sharing_pipeline(roundkeys, plain_sharing, data_sharing, nb_blocks, s);
+		t = my_gettimeofday() - start;
+		aes_decrypt_128_sharing_batch(roundkeys, data_sharing, data_sharing, nb_blocks, 1);
+		compress_n_sharing_buffer(data_sharing, res, bytes);
+		ok = memcmp(plain, res, bytes) == 0;
+		failures += !ok;
+		print_result("pipeline", s, bytes, t, ok);
+		
+		start = my_gettimeofday();
+		aes_encrypt_128_sharing_batch(roundkeys, plain_sharing, data_sharing, nb_blocks, s);
+		t = my_gettimeofday() - start;
+		print_result("batch", s, bytes, t, 1);
+	}
+	
+	free(plain);
+	free(res);
+	free(plain_sharing);
+	free(data_sharing);
+	free_roundkeys_sharing(roundkeys);
+	return failures;
+}
+
+
+/*************************** Randomness ***************************/
+/* ./bench rand [nb_blocks] [max_threads] */
+static int bench_rand(int argc, char ** argv){
+	size_t nb_blocks = argc > 0 ? strtoull(argv[0], NULL, 0) : 256;
+	int max_threads = argc > 1 ? atoi(argv[1]) : parallel_default_threads();
+	size_t bytes = nb_blocks * AES_BLOCK_SIZE;
+	int ok, failures = 0;
+	double start, enc;
+	
+	uint8_t ** roundkeys = new_roundkeys_sharing();
+	uint8_t * plain = random_buffer(bytes);
+	uint8_t * res = (uint8_t *)malloc(bytes);
+	uint8_t * data_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	generate_n_sharing_buffer(plain, data_sharing, bytes);
+	
+#ifdef RAND_RING
+	printf("randomness: background producer rings, NB_SHARES = %d\n", NB_SHARES);
+#else
+	printf("randomness: inline counter (rebuild with make FLAGS=\"-O0 -DRAND_RING\" for the rings), NB_SHARES = %d\n", NB_SHARES);
+#endif
+	
+	for(int t = 1; t <= max_threads; t *= 2){
+		start = my_gettimeofday();
+		aes_encrypt_128_sharing_batch(roundkeys, data_sharing, data_sharing, nb_blocks, t);
+		enc = my_gettimeofday() - start;
+		aes_decrypt_128_sharing_batch(roundkeys, data_sharing, data_sharing, nb_blocks, t);
+		compress_n_sharing_buffer(data_sharing, res, bytes);
+		ok = memcmp(plain, res, bytes) == 0;
+		failures += !ok;
+		print_result("encrypt", t, bytes, enc, ok);
+	}
+	
+#ifdef RAND_RING
+	rand_ring_stats stats;
+	rand_ring_get_stats(&stats);
+	printf("rings %llu, consumed %llu bytes, produced %llu bytes\n",
+		(unsigned long long)stats.rings, (unsigned long long)stats.consumed, (unsigned long long)stats.produced);
+	printf("starvations (consumer waits) %llu, producer waits (ring full) %llu\n",
+		(unsigned long long)stats.starvations, (unsigned long long)stats.producer_waits);
+#endif
+	
+	free(plain);
+	free(res);
+	free(data_sharing);
+	free_roundkeys_sharing(roundkeys);
+	return failures;
+}
+
+
+/*************************** Key refresh ***************************/
+/* ./bench refresh [nb_calls] [nb_blocks] */
+static int bench_refresh(int argc, char ** argv){
+	size_t nb = argc > 0 ? strtoull(argv[0], NULL, 0) : 100000;
+	size_t nb_blocks = argc > 1 ? strtoull(argv[1], NULL, 0) : 256;
+	size_t bytes = nb_blocks * AES_BLOCK_SIZE;
+	uint8_t roundkeys[AES_ROUND_KEY_SIZE];
+	uint8_t check[AES_ROUND_KEY_SIZE];
+	int ok, failures = 0;
+	double start, t;
+	size_t i;
+	int j;
+	
+	for(j = 0; j < AES_ROUND_KEY_SIZE; j++){
+		roundkeys[j] = rand();
+	}
+	uint8_t ** roundkeys_sharing = generate_roundkeys_sharing(roundkeys);
+	
+	printf("round keys refresh, NB_SHARES = %d\n", NB_SHARES);
+	
+	start = my_gettimeofday();
+	for(i = 0; i < nb; i++){
+		for(j = 0; j < AES_ROUND_KEY_SIZE; j++){
+			copy_gadget_function(roundkeys_sharing[j], roundkeys_sharing[j], roundkeys_sharing[j]);
+		}
+	}
+	t = my_gettimeofday() - start;
+	compress_n_sharing_buffer(roundkeys_sharing[0], check, AES_ROUND_KEY_SIZE);
+	ok = memcmp(roundkeys, check, AES_ROUND_KEY_SIZE) == 0;
+	failures += !ok;
+	printf("%-28s %10.3f ns/key  %s\n", "copy_gadget_function", t / nb * 1.0e9, ok ? "OK" : "ERROR");
+	
+	start = my_gettimeofday();
+	for(i = 0; i < nb; i++){
+		refresh_roundkeys_sharing(roundkeys_sharing);
+	}
+	t = my_gettimeofday() - start;
+	compress_n_sharing_buffer(roundkeys_sharing[0], check, AES_ROUND_KEY_SIZE);
+	ok = memcmp(roundkeys, check, AES_ROUND_KEY_SIZE) == 0;
+	failures += !ok;
+	printf("%-28s %10.3f ns/key  %s\n", "refresh_roundkeys_sharing", t / nb * 1.0e9, ok ? "OK" : "ERROR");
+	
+	uint8_t * plain = random_buffer(bytes);
+	uint8_t * res = (uint8_t *)malloc(bytes);
+	uint8_t * data_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	generate_n_sharing_buffer(plain, data_sharing, bytes);
+	
+	start = my_gettimeofday();
+	aes_encrypt_128_sharing_batch(roundkeys_sharing, data_sharing, data_sharing, nb_blocks, 1);
+	t = my_gettimeofday() - start;
+	aes_decrypt_128_sharing_batch(roundkeys_sharing, data_sharing, data_sharing, nb_blocks, 1);
+	compress_n_sharing_buffer(data_sharing, res, bytes);
+	ok = memcmp(plain, res, bytes) == 0;
+	failures += !ok;
+	print_result("encrypt, no refresh", 1, bytes, t, ok);
+	
+	// refresh before every block, then amortized over 16 and 256 blocks
+	for(size_t k = 1; k <= 256; k *= 16){
+		char name[32];
+		start = my_gettimeofday();
+		aes_encrypt_128_sharing_batch_refresh(roundkeys_sharing, data_sharing, data_sharing, nb_blocks, 1, k);
+		t = my_gettimeofday() - start;
+		aes_decrypt_128_sharing_batch_refresh(roundkeys_sharing, data_sharing, data_sharing, nb_blocks, 1, k);
+		compress_n_sharing_buffer(data_sharing, res, bytes);
+		ok = memcmp(plain, res, bytes) == 0;
+		failures += !ok;
+		snprintf(name, sizeof(name), "encrypt, refresh every %zu", k);
+		print_result(name, 1, bytes, t, ok);
+	}
+	
+	free(plain);
+	free(res);
+	free(data_sharing);
+	free_roundkeys_sharing(roundkeys_sharing);
+	return failures;
+}
+
+
+/*************************** Thread team ***************************/
+/* ./bench team [nb_blocks] [max_threads] */
+static int bench_team(int argc, char ** argv){
+	size_t nb_blocks = argc > 0 ? strtoull(argv[0], NULL, 0) : 16;
+	int max_threads = argc > 1 ? atoi(argv[1]) : parallel_default_threads();
+	size_t bytes = nb_blocks * AES_BLOCK_SIZE;
+	uint8_t * in_ptrs[AES_BLOCK_SIZE];
+	uint8_t * out_ptrs[AES_BLOCK_SIZE];
+	int ok, failures = 0;
+	double start, t;
+	size_t b;
+	
+	uint8_t ** roundkeys = new_roundkeys_sharing();
+	uint8_t * plain = random_buffer(bytes);
+	uint8_t * res = (uint8_t *)malloc(bytes);
+	uint8_t * ref = (uint8_t *)malloc(bytes);
+	uint8_t * plain_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	uint8_t * data_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	generate_n_sharing_buffer(plain, plain_sharing, bytes);
+	
+	printf("single block latency, NB_SHARES = %d, %zu blocks\n", NB_SHARES, nb_blocks);
+	
+	start = my_gettimeofday();
+	for(b = 0; b < nb_blocks; b++){
+		block_sharing_pointers(plain_sharing + b * AES_BLOCK_SHARING_SIZE, in_ptrs);
+		block_sharing_pointers(data_sharing + b * AES_BLOCK_SHARING_SIZE, out_ptrs);
+		aes_encrypt_128_sharing(roundkeys, in_ptrs, out_ptrs);
+	}
+	t = my_gettimeofday() - start;
+	compress_n_sharing_buffer(data_sharing, ref, bytes);
+	printf("%-28s threads=%-3d %10.3f us/block\n", "aes_encrypt_128_sharing", 1, t / nb_blocks * 1.0e6);
+	
+	for(int nb = 1; nb <= max_threads && nb <= AES_BLOCK_SIZE; nb *= 2){
+		aes_team * team = aes_team_new(nb);
+		
+		start = my_gettimeofday();
+		for(b = 0; b < nb_blocks; b++){
+			block_sharing_pointers(plain_sharing + b * AES_BLOCK_SHARING_SIZE, in_ptrs);
+			block_sharing_pointers(data_sharing + b * AES_BLOCK_SHARING_SIZE, out_ptrs);
+			aes_encrypt_128_sharing_team(team, roundkeys, in_ptrs, out_ptrs);
+		}
+		t = my_gettimeofday() - start;
+		compress_n_sharing_buffer(data_sharing, res, bytes);
+		ok = memcmp(ref, res, bytes) == 0;
+		
+		for(b = 0; b < nb_blocks; b++){
+			block_sharing_pointers(data_sharing + b * AES_BLOCK_SHARING_SIZE, in_ptrs);
+			aes_decrypt_128_sharing_team(team, roundkeys, in_ptrs, in_ptrs);
+		}
+		compress_n_sharing_buffer(data_sharing, res, bytes);
+		ok = ok && memcmp(plain, res, bytes) == 0;
+		failures += !ok;
+		printf("%-28s threads=%-3d %10.3f us/block  %s\n", "team", aes_team_size(team), t / nb_blocks * 1.0e6, ok ? "OK" : "ERROR");
+		
+		aes_team_free(team);
+	}
+	
+	free(plain);
+	free(res);
+	free(ref);
+	free(plain_sharing);
+	free(data_sharing);
+	free_roundkeys_sharing(roundkeys);
+	return failures;
+}
+
+
+/*************************** Masking order ***************************/
+/* ./bench order [nb_blocks] [header], see make bench_orders */
+static int bench_order(int argc, char ** argv){
+	size_t nb_blocks = argc > 0 ? strtoull(argv[0], NULL, 0) : 1;
+	int header = argc > 1 ? atoi(argv[1]) : 1;
+	size_t bytes = nb_blocks * AES_BLOCK_SIZE;
+	struct rusage usage;
+	int ok;
+	double start, t;
+	
+	uint8_t ** roundkeys = new_roundkeys_sharing();
+	uint8_t * plain = random_buffer(bytes);
+	uint8_t * res = (uint8_t *)malloc(bytes);
+	uint8_t * data_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	generate_n_sharing_buffer(plain, data_sharing, bytes);
+	
+	start = my_gettimeofday();
+	aes_encrypt_128_sharing_batch(roundkeys, data_sharing, data_sharing, nb_blocks, 1);
+	t = my_gettimeofday() - start;
+	aes_decrypt_128_sharing_batch(roundkeys, data_sharing, data_sharing, nb_blocks, 1);
+	compress_n_sharing_buffer(data_sharing, res, bytes);
+	ok = memcmp(plain, res, bytes) == 0;
+	getrusage(RUSAGE_SELF, &usage);
+	
+	// the cipher itself uses the round keys and the scratch arena of each thread
+	if(header)
+		printf("%9s %14s %14s %14s %12s\n", "NB_SHARES", "us/block", "round keys", "scratch", "max RSS kB");
+	printf("%9d %14.1f %14zu %14zu %12ld  %s\n", NB_SHARES, t / nb_blocks * 1.0e6,
+		(size_t)AES_ROUND_KEY_SIZE * NB_SHARES, (size_t)SCRATCH_VARS * NB_SHARES, usage.ru_maxrss, ok ? "OK" : "ERROR");
+	
+	free(plain);
+	free(res);
+	free(data_sharing);
+	free_roundkeys_sharing(roundkeys);
+	return !ok;
+}
+
+
+/*************************** Masking overhead ***************************/
+/* ./bench overhead [nb_blocks] [header], see make bench_orders */
+
+// the unmasked operations are repeated to be measurable
+#define OVERHEAD_REPEAT 1000
+
+static int bench_overhead(int argc, char ** argv){
+	size_t nb_blocks = argc > 0 ? strtoull(argv[0], NULL, 0) : 4;
+	int header = argc > 1 ? atoi(argv[1]) : 1;
+	size_t bytes = nb_blocks * AES_BLOCK_SIZE;
+	size_t nb_ref = nb_blocks * OVERHEAD_REPEAT;
+	uint8_t key[AES_BLOCK_SIZE], rk[AES_ROUND_KEY_SIZE], state[AES_BLOCK_SIZE];
+	uint8_t ind_state[AES_BLOCK_SIZE];
+	uint8_t * column[AES_BLOCK_SIZE];
+	volatile uint8_t sink = 0;
+	double start, t_masked, t_ref, t_ni = 0, t_sbox, t_sbox_ref, t_mix, t_mix_ref;
+	int ok;
+	
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		key[i] = rand();
+		ind_state[i] = i;
+	}
+	aes_key_expansion_128(key, rk);
+	uint8_t ** roundkeys = generate_roundkeys_sharing(rk);
+	
+	uint8_t * plain = random_buffer(bytes);
+	uint8_t * ref = (uint8_t *)malloc(bytes);
+	uint8_t * res = (uint8_t *)malloc(bytes);
+	uint8_t * data_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		column[i] = data_sharing + i * NB_SHARES;
+	}
+	
+	// whole block: n-share cipher against the reference ones, which also check it
+	generate_n_sharing_buffer(plain, data_sharing, bytes);
+	start = my_gettimeofday();
+	aes_encrypt_128_sharing_batch(roundkeys, data_sharing, data_sharing, nb_blocks, 1);
+	t_masked = (my_gettimeofday() - start) / nb_blocks;
+	compress_n_sharing_buffer(data_sharing, res, bytes);
+	
+	memcpy(state, plain, AES_BLOCK_SIZE);
+	start = my_gettimeofday();
+	for(size_t j = 0; j < nb_ref / 10; j++){
+		aes_encrypt_128(rk, state, state);
+	}
+	t_ref = (my_gettimeofday() - start) / (nb_ref / 10);
+	sink ^= state[0];
+	for(size_t j = 0; j < nb_blocks; j++){
+		aes_encrypt_128(rk, plain + j * AES_BLOCK_SIZE, ref + j * AES_BLOCK_SIZE);
+	}
+	ok = memcmp(ref, res, bytes) == 0;
+	
+	if(aes_ni_available()){
+		uint8_t * ni = (uint8_t *)malloc(bytes);
+		start = my_gettimeofday();
+		for(size_t k = 0; k < OVERHEAD_REPEAT; k++){
+			aes_encrypt_128_blocks(rk, plain, ni, nb_blocks);
+		}
+		t_ni = (my_gettimeofday() - start) / nb_ref;
+		ok &= memcmp(ref, ni, bytes) == 0;
+		aes_decrypt_128_blocks(rk, ni, ni, nb_blocks);
+		ok &= memcmp(plain, ni, bytes) == 0;
+		free(ni);
+	}
+	
+	// S-box
+	start = my_gettimeofday();
+	for(size_t j = 0; j < nb_blocks; j++){
+		get_sbox_value_sharing(column[j % AES_BLOCK_SIZE], column[j % AES_BLOCK_SIZE]);
+	}
+	t_sbox = (my_gettimeofday() - start) / nb_blocks;
+	start = my_gettimeofday();
+	for(size_t j = 0; j < nb_ref; j++){
+		sink = aes_sbox(sink ^ j);
+	}
+	t_sbox_ref = (my_gettimeofday() - start) / nb_ref;
+	
+	// MixColumns
+	start = my_gettimeofday();
+	for(size_t j = 0; j < nb_blocks; j++){
+		mix_columns_sharing(column, column, ind_state);
+	}
+	t_mix = (my_gettimeofday() - start) / nb_blocks;
+	start = my_gettimeofday();
+	for(size_t j = 0; j < nb_ref; j++){
+		aes_mix_columns(state);
+	}
+	t_mix_ref = (my_gettimeofday() - start) / nb_ref;
+	sink ^= state[0];
+	
+	// masked / unmasked time, i.e. unmasked / masked throughput
+	if(header)
+		printf("%9s %12s %12s %12s %12s %12s\n", "NB_SHARES", "us/block", "x reference", "x AES-NI", "x S-box", "x MixColumns");
+	printf("%9d %12.1f %12.0f ", NB_SHARES, t_masked * 1.0e6, t_masked / t_ref);
+	if(t_ni > 0)
+		printf("%12.0f ", t_masked / t_ni);
+	else
+		printf("%12s ", "-");
+	printf("%12.0f %12.0f  %s\n", t_sbox / t_sbox_ref, t_mix / t_mix_ref, ok ? "OK" : "ERROR");
+	
+	free(plain);
+	free(ref);
+	free(res);
+	free(data_sharing);
+	free_roundkeys_sharing(roundkeys);
+	return !ok;
+}
+
+
+/*************************** Multi-key batches ***************************/
+/* ./bench multikey [nb_messages] [blocks_per_message] [max_threads] */
+static int bench_multikey(int argc, char ** argv){
+	size_t nb_msgs = argc > 0 ? strtoull(argv[0], NULL, 0) : 64;
+	size_t msg_blocks = argc > 1 ? strtoull(argv[1], NULL, 0) : 1;
+	int max_threads = argc > 2 ? atoi(argv[2]) : parallel_default_threads();
+	size_t nb_blocks = nb_msgs * msg_blocks;
+	size_t bytes = nb_blocks * AES_BLOCK_SIZE;
+	int ok, failures = 0;
+	double start, t;
+	size_t m;
+	
+	// one key per message
+	uint8_t *** roundkeys = (uint8_t ***)malloc(nb_msgs * sizeof(uint8_t **));
+	uint32_t * key_index = (uint32_t *)malloc(nb_blocks * sizeof(uint32_t));
+	for(m = 0; m < nb_msgs; m++){
+		roundkeys[m] = new_roundkeys_sharing();
+	}
+	for(size_t b = 0; b < nb_blocks; b++){
+		key_index[b] = b / msg_blocks;
+	}
+	
+	start = my_gettimeofday();
+	roundkeys_table * table = roundkeys_table_new(roundkeys, nb_msgs);
+	t = my_gettimeofday() - start;
+	printf("multi-key, NB_SHARES = %d, %zu messages of %zu blocks, key table built in %.3f ms\n", NB_SHARES, nb_msgs, msg_blocks, t * 1000);
+	
+	uint8_t * plain = random_buffer(bytes);
+	uint8_t * res = (uint8_t *)malloc(bytes);
+	uint8_t * ref = (uint8_t *)malloc(bytes);
+	uint8_t * data_sharing = (uint8_t *)malloc(bytes * NB_SHARES);
+	
+	for(int nb_threads = 1; nb_threads <= max_threads; nb_threads *= 2){
+		// the same blocks under a single key, as the target throughput
+		generate_n_sharing_buffer(plain, data_sharing, bytes);
+		start = my_gettimeofday();
+		aes_encrypt_128_sharing_batch(roundkeys[0], data_sharing, data_sharing, nb_blocks, nb_threads);
+		t = my_gettimeofday() - start;
+		aes_decrypt_128_sharing_batch(roundkeys[0], data_sharing, data_sharing, nb_blocks, nb_threads);
+		compress_n_sharing_buffer(data_sharing, res, bytes);
+		ok = memcmp(plain, res, bytes) == 0;
+		failures += !ok;
+		print_result("single key batch", nb_threads, bytes, t, ok);
+		
+		// one batch per message
+		generate_n_sharing_buffer(plain, data_sharing, bytes);
+		start = my_gettimeofday();
+		for(m = 0; m < nb_msgs; m++){
+			aes_encrypt_128_sharing_batch(roundkeys[m], data_sharing + m * msg_blocks * AES_BLOCK_SHARING_SIZE,
+				data_sharing + m * msg_blocks * AES_BLOCK_SHARING_SIZE, msg_blocks, nb_threads);
+		}
+		t = my_gettimeofday() - start;
+		compress_n_sharing_buffer(data_sharing, ref, bytes);
+		print_result("batch per message", nb_threads, bytes, t, 1);
+		
+		// all the messages in one batch, and the same ciphertexts as above
+		generate_n_sharing_buffer(plain, data_sharing, bytes);
+		start = my_gettimeofday();
+		aes_encrypt_128_sharing_batch_multikey(table, key_index, data_sharing, data_sharing, nb_blocks, nb_threads);
+		t = my_gettimeofday() - start;
+		compress_n_sharing_buffer(data_sharing, res, bytes);
+		ok = memcmp(ref, res, bytes) == 0;
+		aes_decrypt_128_sharing_batch_multikey(table, key_index, data_sharing, data_sharing, nb_blocks, nb_threads);
+		compress_n_sharing_buffer(data_sharing, res, bytes);
+		ok &= memcmp(plain, res, bytes) == 0;
+		failures += !ok;
+		print_result("multi-key batch", nb_threads, bytes, t, ok);
+	}
+	
+	free(plain);
+	free(res);
+	free(ref);
+	free(data_sharing);
+	roundkeys_table_free(table);
+	for(m = 0; m < nb_msgs; m++){
+		free_roundkeys_sharing(roundkeys[m]);
+	}
+	free(roundkeys);
+	free(key_index);
+	return failures;
+}
+
+
+/*************************** Key store ***************************/
+/* ./bench keystore [nb_keys] [path] */
+static int bench_keystore(int argc, char ** argv){
+	size_t nb_keys = argc > 0 ? strtoull(argv[0], NULL, 0) : 100000;
+	const char * path = argc > 1 ? argv[1] : "/tmp/bench.keys";
+	static const int flags[4] = { 0, KEYSTORE_VERIFY, KEYSTORE_RERANDOMIZE, KEYSTORE_VERIFY | KEYSTORE_RERANDOMIZE };
+	static const char * names[4] = { "open", "open, verify", "open, re-randomize", "open, verify, re-randomize" };
+	uint8_t key[AES_BLOCK_SIZE], rk[AES_ROUND_KEY_SIZE], first_rk[AES_ROUND_KEY_SIZE], last_rk[AES_ROUND_KEY_SIZE];
+	uint8_t plain[AES_BLOCK_SIZE], ref[AES_BLOCK_SIZE], res[AES_BLOCK_SIZE];
+	uint8_t * ptrs[AES_ROUND_KEY_SIZE];
+	uint8_t * block_ptrs[AES_BLOCK_SIZE];
+	uint8_t block_sharing[AES_BLOCK_SHARING_SIZE];
+	int ok = 1, failures = 0;
+	double start, t;
+	
+	if(nb_keys == 0)
+		nb_keys = 1;
+	uint8_t * sharings = (uint8_t *)malloc(nb_keys * AES_ROUND_KEY_SIZE * NB_SHARES);
+	printf("key store, NB_SHARES = %d, %zu keys, %s\n", NB_SHARES, nb_keys, path);
+	
+	// what a restart costs without the store
+	start = my_gettimeofday();
+	for(size_t k = 0; k < nb_keys; k++){
+		for(int i = 0; i < AES_BLOCK_SIZE; i++){
+			key[i] = rand();
+		}
+		aes_key_expansion_128(key, rk);
+		generate_n_sharing_buffer(rk, sharings + k * AES_ROUND_KEY_SIZE * NB_SHARES, AES_ROUND_KEY_SIZE);
+		if(k == 0)
+			memcpy(first_rk, rk, AES_ROUND_KEY_SIZE);
+		memcpy(last_rk, rk, AES_ROUND_KEY_SIZE);
+	}
+	t = my_gettimeofday() - start;
+	printf("%-28s %12.3f ms\n", "expand and share", t * 1000);
+	
+	start = my_gettimeofday();
+	if(keystore_write(path, sharings, nb_keys) < 0){
+		perror(path);
+		free(sharings);
+		return 1;
+	}
+	t = my_gettimeofday() - start;
+	printf("%-28s %12.3f ms\n", "write", t * 1000);
+	free(sharings);
+	
+	for(int i = 0; i < AES_BLOCK_SIZE; i++){
+		plain[i] = rand();
+	}
+	block_sharing_pointers(block_sharing, block_ptrs);
+	
+	// the file was just written, so these are warm page cache timings
+	for(int f = 0; f < 4; f++){
+		start = my_gettimeofday();
+		keystore * store = keystore_open(path, flags[f]);
+		t = my_gettimeofday() - start;
+		if(store == NULL){
+			perror(path);
+			failures++;
+			continue;
+		}
+		
+		// the first and last keys, straight from the mapping
+		ok = keystore_nb_keys(store) == nb_keys;
+		for(int side = 0; side < 2; side++){
+			keystore_roundkeys(store, side ? nb_keys - 1 : 0, ptrs);
+			generate_n_sharing_buffer(plain, block_sharing, AES_BLOCK_SIZE);
+			aes_encrypt_128_sharing(ptrs, block_ptrs, block_ptrs);
+			compress_n_sharing_buffer(block_sharing, res, AES_BLOCK_SIZE);
+			aes_encrypt_128(side ? last_rk : first_rk, plain, ref);
+			ok &= memcmp(ref, res, AES_BLOCK_SIZE) == 0;
+		}
+		failures += !ok;
+		printf("%-28s %12.3f ms  %s\n", names[f], t * 1000, ok ? "OK" : "ERROR");
+		keystore_close(store);
+	}
+	
+	unlink(path);
+	return failures;
+}
+
+
+/*************************** CMAC ***************************/
+/* ./bench cmac [nb_messages] [message_bytes] [max_threads] */
+static int bench_cmac(int argc, char ** argv){
+	size_t nb_msgs = argc > 0 ? strtoull(argv[0], NULL, 0) : 64;
+	size_t msg_bytes = argc > 1 ? strtoull(argv[1], NULL, 0) : 1024;
+	int max_threads = argc > 2 ? atoi(argv[2]) : parallel_default_threads();
+	int ok, failures = 0;
+	double start, elapsed;
+	
+	// RFC 4493 test vectors
+	static const uint8_t key[AES_BLOCK_SIZE] = {
+		0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+	static const uint8_t rfc_msg[64] = {
+		0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+		0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+		0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+		0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10 };
+	static const size_t rfc_len[4] = { 0, 16, 40, 64 };
+	static const uint8_t rfc_tag[4][AES_BLOCK_SIZE] = {
+		{ 0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28, 0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46 },
+		{ 0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44, 0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c },
+		{ 0xdf, 0xa6, 0x67, 0x47, 0xde, 0x9a, 0xe6, 0x30, 0x30, 0xca, 0x32, 0x61, 0x14, 0x97, 0xc8, 0x27 },
+		{ 0x51, 0xf0, 0xbe, 0xbf, 0x7e, 0x3b, 0x9d, 0x92, 0xfc, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3c, 0xfe } };
+	static const uint8_t rfc_k1[AES_BLOCK_SIZE] = {
+		0xfb, 0xee, 0xd6, 0x18, 0x35, 0x71, 0x33, 0x66, 0x7c, 0x85, 0xe0, 0x8f, 0x72, 0x36, 0xa8, 0xde };
+	static const uint8_t rfc_k2[AES_BLOCK_SIZE] = {
+		0xf7, 0xdd, 0xac, 0x30, 0x6a, 0xe2, 0x66, 0xcc, 0xf9, 0x0b, 0xc1, 0x1e, 0xe4, 0x6d, 0x51, 0x3b };
+	
+	uint8_t roundkeys[AES_ROUND_KEY_SIZE];
+	aes_key_expansion_128(key, roundkeys);
+	uint8_t ** roundkeys_sharing = generate_roundkeys_sharing(roundkeys);
+	uint8_t * k1 = (uint8_t *)malloc(AES_BLOCK_SHARING_SIZE);
+	uint8_t * k2 = (uint8_t *)malloc(AES_BLOCK_SHARING_SIZE);
+	uint8_t res[AES_BLOCK_SIZE];
+	
+	printf("CMAC, NB_SHARES = %d\n", NB_SHARES);
+	
+	aes_cmac_subkeys_128_sharing(roundkeys_sharing, k1, k2);
+	compress_n_sharing_buffer(k1, res, AES_BLOCK_SIZE);
+	ok = memcmp(res, rfc_k1, AES_BLOCK_SIZE) == 0;
+	compress_n_sharing_buffer(k2, res, AES_BLOCK_SIZE);
+	ok &= memcmp(res, rfc_k2, AES_BLOCK_SIZE) == 0;
+	
+	uint8_t * rfc_sharing = (uint8_t *)malloc(sizeof(rfc_msg) * NB_SHARES);
+	uint8_t * rfc_tags = (uint8_t *)malloc(4 * AES_BLOCK_SHARING_SIZE);
+	cmac_message_sharing rfc_msgs[4];
+	generate_n_sharing_buffer(rfc_msg, rfc_sharing, sizeof(rfc_msg));
+	for(int v = 0; v < 4; v++){
+		aes_cmac_128_sharing(roundkeys_sharing, k1, k2, rfc_sharing, rfc_len[v], rfc_tags + v * AES_BLOCK_SHARING_SIZE);
+		compress_n_sharing_buffer(rfc_tags + v * AES_BLOCK_SHARING_SIZE, res, AES_BLOCK_SIZE);
+		ok &= memcmp(res, rfc_tag[v], AES_BLOCK_SIZE) == 0;
+		rfc_msgs[v].msg = rfc_sharing;
+		rfc_msgs[v].len = rfc_len[v];
+		rfc_msgs[v].tag = rfc_tags + v * AES_BLOCK_SHARING_SIZE;
+	}
+	aes_cmac_128_sharing_multi(roundkeys_sharing, k1, k2, rfc_msgs, 4, max_threads);
+	for(int v = 0; v < 4; v++){
+		compress_n_sharing_buffer(rfc_msgs[v].tag, res, AES_BLOCK_SIZE);
+		ok &= memcmp(res, rfc_tag[v], AES_BLOCK_SIZE) == 0;
+	}
+	failures += !ok;
+	printf("RFC 4493 test vectors : %s\n", ok ? "OK" : "ERROR");
+	free(rfc_sharing);
+	free(rfc_tags);
+	
+	// nb_msgs independent messages under the same key
+	size_t msg_sharing_size = msg_bytes * NB_SHARES;
+	uint8_t * msgs_sharing = (uint8_t *)malloc(nb_msgs * msg_sharing_size);
+	uint8_t * tags = (uint8_t *)malloc(nb_msgs * AES_BLOCK_SHARING_SIZE);
+	uint8_t * ref = (uint8_t *)malloc(nb_msgs * AES_BLOCK_SIZE);
+	uint8_t * out = (uint8_t *)malloc(nb_msgs * AES_BLOCK_SIZE);
+	uint8_t * plain = random_buffer(nb_msgs * msg_bytes);
+	generate_n_sharing_buffer(plain, msgs_sharing, nb_msgs * msg_bytes);
+	cmac_message_sharing * msgs = (cmac_message_sharing *)malloc(nb_msgs * sizeof(cmac_message_sharing));
+	for(size_t m = 0; m < nb_msgs; m++){
+		msgs[m].msg = msgs_sharing + m * msg_sharing_size;
+		msgs[m].len = msg_bytes;
+		msgs[m].tag = tags + m * AES_BLOCK_SHARING_SIZE;
+	}
+	
+	start = my_gettimeofday();
+	for(size_t m = 0; m < nb_msgs; m++){
+		aes_cmac_128_sharing(roundkeys_sharing, k1, k2, msgs[m].msg, msgs[m].len, msgs[m].tag);
+	}
+	elapsed = my_gettimeofday() - start;
+	compress_n_sharing_buffer(tags, ref, nb_msgs * AES_BLOCK_SIZE);
+	print_result("cmac one message at a time", 1, nb_msgs * msg_bytes, elapsed, 1);
+	
+	for(int t = 1; t <= max_threads; t *= 2){
+		start = my_gettimeofday();
+		aes_cmac_128_sharing_multi(roundkeys_sharing, k1, k2, msgs, nb_msgs, t);
+		elapsed = my_gettimeofday() - start;
+		compress_n_sharing_buffer(tags, out, nb_msgs * AES_BLOCK_SIZE);
+		ok = memcmp(ref, out, nb_msgs * AES_BLOCK_SIZE) == 0;
+		failures += !ok;
+		print_result("cmac multi-message", t, nb_msgs * msg_bytes, elapsed, ok);
+	}
+	
+	free(msgs);
+	free(plain);
+	free(out);
+	free(ref);
+	free(tags);
+	free(msgs_sharing);
+	free(k1);
+	free(k2);
+	free_roundkeys_sharing(roundkeys_sharing);
+	return failures;
+}
+
+
+/*************************** Multiplication gadget ***************************/
+/* ./bench mult [nb_calls] [header], see make bench_orders */
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define read_cycles() __rdtsc()
+#else
+#define read_cycles() (uint64_t)(my_gettimeofday() * 1.0e9)    // ns
+#endif
+
+#ifdef GADGETS_FAST_PATH
+// 2 or 3 shares: the single inline gadget of gadgets_base.h in both columns
+#define mult_gadget_function_scalar mult_gadget_function
+#define mult_gadget_function_simd mult_gadget_function
+#endif
+
+typedef void (*mult_fn)(uint8_t * a, uint8_t * b, uint8_t * c);
+
+/**********************************************************
+ * Cycles per call of fn, and check of its output against
+ * the one of the scalar gadget, c_p = a_p * (b_0 + ... )
+**********************************************************/
+static double run_mult(mult_fn fn, size_t nb, int * ok){
+	uint8_t a[NB_SHARES], b[NB_SHARES], c[NB_SHARES];
+	uint64_t cycles = 0, start;
+	
+	*ok = 1;
+	for(size_t i = 0; i < nb; i++){
+		if(i % 64 == 0){
+			generate_n_sharing(rand(), a);
+			generate_n_sharing(rand(), b);
+		}
+		start = read_cycles();
+		fn(a, b, c);
+		cycles += read_cycles() - start;
+		if(i % 64 == 0){
+			uint8_t bv = compress_n_sharing(b);
+			for(int p = 0; p < NB_SHARES; p++){
+				*ok &= c[p] == Multiply(a[p], bv);
+			}
+		}
+	}
+	return (double)cycles / nb;
+}
+
+static int bench_mult(int argc, char ** argv){
+	size_t nb = argc > 0 ? strtoull(argv[0], NULL, 0) : 10000;
+	int header = argc > 1 ? atoi(argv[1]) : 1;
+	int ok, failures = 0;
+	double scalar, simd;
+	
+	scalar = run_mult(mult_gadget_function_scalar, nb, &ok);
+	failures += !ok;
+	simd = run_mult(mult_gadget_function_simd, nb, &ok);
+	failures += !ok;
+	
+	if(header)
+		printf("%9s %16s %16s %8s  (%s, vector version from %d shares)\n", "NB_SHARES", "scalar cyc/call", "vector cyc/call", "speedup",
+			__builtin_cpu_supports("gfni") ? "GFNI" : "no GFNI, scalar", MULT_SIMD_MIN_SHARES);
+	printf("%9d %16.1f %16.1f %8.2f  %s\n", NB_SHARES, scalar, simd, simd > 0 ? scalar / simd : 0.0, failures ? "ERROR" : "OK");
+	return failures;
+}
+
+
+/*************************** Expansion-level gadgets ***************************/
+/* ./bench expand [nb_calls] [header], see make bench_orders */
+#ifdef GADGETS_FAST_PATH
+// 3 shares: the iterative gadgets are the inline ones of gadgets_base.h
+#define add_gadget_function_iterative add_gadget_function
+#define copy_gadget_function_iterative copy_gadget_function
+#define mult_gadget_function_iterative mult_gadget_function
+#endif
+
+typedef struct {
+	void (*add)(uint8_t * a, uint8_t * b, uint8_t * c);
+	void (*copy)(uint8_t * a, uint8_t * d, uint8_t * e);
+	void (*mult)(uint8_t * a, uint8_t * b, uint8_t * c);
+} gadget_set;
+
+/**********************************************************
+ * ns per call of the addition, copy and multiplication 
+ * gadgets of g, with a check of their outputs
+**********************************************************/
+static void run_gadget_set(const gadget_set * g, size_t nb, double * t, int * ok){
+	uint8_t a[NB_SHARES], b[NB_SHARES], c[NB_SHARES], d[NB_SHARES];
+	uint8_t va = rand(), vb = rand();
+	double start;
+	
+	generate_n_sharing(va, a);
+	generate_n_sharing(vb, b);
+	g->add(a, b, c);
+	*ok &= compress_n_sharing(c) == (va ^ vb);
+	g->copy(a, c, d);
+	*ok &= compress_n_sharing(c) == va && compress_n_sharing(d) == va;
+	g->mult(a, b, c);
+	*ok &= compress_n_sharing(c) == Multiply(va, vb);
+	
+	start = my_gettimeofday();
+	for(size_t i = 0; i < nb; i++){
+		g->add(a, b, a);
+	}
+	t[0] = (my_gettimeofday() - start) / nb * 1.0e9;
+	start = my_gettimeofday();
+	for(size_t i = 0; i < nb; i++){
+		g->copy(a, a, c);
+	}
+	t[1] = (my_gettimeofday() - start) / nb * 1.0e9;
+	start = my_gettimeofday();
+	for(size_t i = 0; i < nb; i++){
+		g->mult(a, b, a);
+	}
+	t[2] = (my_gettimeofday() - start) / nb * 1.0e9;
+}
+
+static int bench_expand(int argc, char ** argv){
+	size_t nb = argc > 0 ? strtoull(argv[0], NULL, 0) : 1000;
+	int header = argc > 1 ? atoi(argv[1]) : 1;
+	const gadget_set iterative = { add_gadget_function_iterative, copy_gadget_function_iterative, mult_gadget_function_iterative };
+	double t_it[3], t_exp[3];
+	int ok = 1;
+	
+	run_gadget_set(&iterative, nb, t_it, &ok);
+#if GADGETS_EXPANSION_LEVEL
+	const gadget_set expand = { add_gadget_function_expand, copy_gadget_function_expand, mult_gadget_function_expand };
+	run_gadget_set(&expand, nb, t_exp, &ok);
+#endif
+	
+	if(header)
+		printf("%9s %6s %12s %12s %12s %12s %12s %12s  (ns/call)\n", "NB_SHARES", "level",
+			"add iter", "add exp", "copy iter", "copy exp", "mult iter", "mult exp");
+	printf("%9d %6d", NB_SHARES, GADGETS_EXPANSION_LEVEL);
+	for(int k = 0; k < 3; k++){
+		printf(" %12.1f", t_it[k]);
+		if(GADGETS_EXPANSION_LEVEL)
+			printf(" %12.1f", t_exp[k]);
+		else
+			printf(" %12s", "-");
+	}
+	printf("  %s\n", ok ? "OK" : "ERROR");
+	return !ok;
+}
+
+
+typedef struct {
+	const char * name;
+	int (*run)(int argc, char ** argv);
+	const char * usage;
+} bench_entry;
+
+static const bench_entry benches[] = {
+	{ "cbc", bench_cbc, "[bytes] [max_threads] [messages]" },
+	{ "xts", bench_xts, "[sector_size] [nb_sectors] [max_threads]" },
+	{ "keycache", bench_keycache, "[nb_handles] [cache_entries] [lookups_per_thread] [max_threads]" },
+	{ "perf", bench_perf, "[nb_blocks] [csv_file]" },
+	{ "rand", bench_rand, "[nb_blocks] [max_threads]" },
+	{ "mask", bench_mask, "[bytes]" },
+	{ "sbox", bench_sbox, "[nb]" },
+	{ "gadgets", bench_gadgets, "[nb_calls] [nb_blocks]" },
+	{ "pipeline", bench_pipeline, "[nb_blocks] [max_stages]" },
+	{ "refresh", bench_refresh, "[nb_calls] [nb_blocks]" },
+	{ "team", bench_team, "[nb_blocks] [max_threads]" },
+	{ "order", bench_order, "[nb_blocks] [header]" },
+	{ "mult", bench_mult, "[nb_calls] [header]" },
+	{ "overhead", bench_overhead, "[nb_blocks] [header]" },
+	{ "expand", bench_expand, "[nb_calls] [header]" },
+	{ "multikey", bench_multikey, "[nb_messages] [blocks_per_message] [max_threads]" },
+	{ "keystore", bench_keystore, "[nb_keys] [path]" },
+	{ "cmac", bench_cmac, "[nb_messages] [message_bytes] [max_threads]" },
+};
+
+#define NB_BENCHES (sizeof(benches) / sizeof(benches[0]))
+
+
+int main(int argc, char ** argv){
+	
+	srand(time(NULL));
+	
+	if(argc < 2){
+		printf("usage: %s <benchmark> [options]\n", argv[0]);
+		for(size_t b = 0; b < NB_BENCHES; b++){
+			printf("    %s %s\n", benches[b].name, benches[b].usage);
+		}
+		return EXIT_FAILURE;
+	}
+	
+	for(size_t b = 0; b < NB_BENCHES; b++){
+		if(strcmp(argv[1], benches[b].name) == 0)
+			return benches[b].run(argc - 2, argv + 2) ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+	
+	printf("unknown benchmark %s\n", argv[1]);
+	return EXIT_FAILURE;
+}
@@ -35,6 +35,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/time.h>
@@ -42,6 +43,7 @@
 #include "./aes_files/gf256.h"
 #include "./aes_files/gadgets.h"
 #include "./aes_files/aes128_sharing.h"
+#include "./aes_files/aes128.h"
 
 double my_gettimeofday(){
   struct timeval tmp_time;
@@ -51,16 +53,12 @@ double my_gettimeofday(){
 
 int main(int argc, char ** argv){
 	
-	for(int i=0; i<NB_SHARES; i++){
-		const_s[i] = 0;
-	}
-	
 	srand(time(NULL));
 	
-	double start, end, aes_enc, aes_dec, aes_sharing_enc, aes_sharing_dec;
+	double start, end, aes_enc, aes_dec, aes_sharing_enc, aes_sharing_dec, aes_sharing_dec_eq;
 	
 
-	uint8_t i, r;
+	int i;
 	uint8_t key[] = {
 		0x0f, 0x15, 0x71, 0xc9, 0x47, 0xd9, 0xe8, 0x59, 
 		0x0c, 0xb7, 0xad, 0xd6, 0xaf, 0x7f, 0x67, 0x98,
@@ -81,19 +79,32 @@ int main(int argc, char ** argv){
 	
 	uint8_t plaintext_res[AES_BLOCK_SIZE];
 	
+	aes_key_expansion_128(key, roundkeys);
+	
 	
 	/*************************** Generating Sharings of texts and keys ***************************/
+	// one buffer for the shares of each table (see aes128_batch.h)
 	uint8_t ** plaintext_sharing = (uint8_t **)malloc(AES_BLOCK_SIZE * sizeof(uint8_t *));
 	uint8_t ** plaintext_res_sharing = (uint8_t **)malloc(AES_BLOCK_SIZE * sizeof(uint8_t *));
+	uint8_t ** plaintext_eq_sharing = (uint8_t **)malloc(AES_BLOCK_SIZE * sizeof(uint8_t *));
 	uint8_t ** ciphertext_sharing = (uint8_t **)malloc(AES_BLOCK_SIZE * sizeof(uint8_t *));
+	uint8_t * plaintext_shares = (uint8_t *)malloc(AES_BLOCK_SIZE * NB_SHARES);
+	uint8_t * plaintext_res_shares = (uint8_t *)malloc(AES_BLOCK_SIZE * NB_SHARES);
+	uint8_t * plaintext_eq_shares = (uint8_t *)malloc(AES_BLOCK_SIZE * NB_SHARES);
+	uint8_t * ciphertext_shares = (uint8_t *)malloc(AES_BLOCK_SIZE * NB_SHARES);
 	for(i =0; i< AES_BLOCK_SIZE; i++){
-		plaintext_sharing[i] = (uint8_t *)malloc(NB_SHARES * sizeof(uint8_t));
-		plaintext_res_sharing[i] = (uint8_t *)malloc(NB_SHARES * sizeof(uint8_t));
-		ciphertext_sharing[i] = (uint8_t *)malloc(NB_SHARES * sizeof(uint8_t));
+		plaintext_sharing[i] = plaintext_shares + i * NB_SHARES;
+		plaintext_res_sharing[i] = plaintext_res_shares + i * NB_SHARES;
+		plaintext_eq_sharing[i] = plaintext_eq_shares + i * NB_SHARES;
+		ciphertext_sharing[i] = ciphertext_shares + i * NB_SHARES;
 	}
 	uint8_t ** roundkeys_sharing = (uint8_t **)malloc(AES_ROUND_KEY_SIZE * sizeof(uint8_t *));
+	uint8_t * roundkeys_shares = (uint8_t *)malloc(AES_ROUND_KEY_SIZE * NB_SHARES);
+	uint8_t ** inv_roundkeys_sharing = (uint8_t **)malloc(AES_ROUND_KEY_SIZE * sizeof(uint8_t *));
+	uint8_t * inv_roundkeys_shares = (uint8_t *)malloc(AES_ROUND_KEY_SIZE * NB_SHARES);
 	for(i=0; i<AES_ROUND_KEY_SIZE; i++){
-		roundkeys_sharing[i] = (uint8_t *)malloc(NB_SHARES * sizeof(uint8_t));
+		roundkeys_sharing[i] = roundkeys_shares + i * NB_SHARES;
+		inv_roundkeys_sharing[i] = inv_roundkeys_shares + i * NB_SHARES;
 	}
 	
 	for(i =0; i<AES_BLOCK_SIZE; i++){
@@ -103,6 +114,25 @@ int main(int argc, char ** argv){
 	for(i =0; i<AES_ROUND_KEY_SIZE; i++){
 		generate_n_sharing(roundkeys[i], roundkeys_sharing[i]);
 	}
+	// round keys of the equivalent inverse cipher, once per key
+	aes_inv_roundkeys_sharing(roundkeys_sharing, inv_roundkeys_sharing);
+	
+	
+	/*************************** Unmasked Reference AES-128 Encryption / Decryption ***************************/
+	start = my_gettimeofday();
+	aes_encrypt_128(roundkeys, plaintext, ciphertext);
+	end = my_gettimeofday();
+	aes_enc = end - start;
+	
+	start = my_gettimeofday();
+	aes_decrypt_128(roundkeys, ciphertext, plaintext_res);
+	end = my_gettimeofday();
+	aes_dec = end - start;
+	
+	if(memcmp(ciphertext, const_cipher, AES_BLOCK_SIZE) != 0 || memcmp(plaintext_res, plaintext, AES_BLOCK_SIZE) != 0){
+		printf("REFERENCE ERROR\n");
+		exit(EXIT_FAILURE);
+	}
 	
 	
 	/*************************** AES-128 Sharing Secure Encryption / Decryption ***************************/
@@ -116,13 +146,26 @@ int main(int argc, char ** argv){
 	end = my_gettimeofday();
 	aes_sharing_dec = end - start;
 	
+	start = my_gettimeofday();
+	aes_decrypt_128_sharing_eq(inv_roundkeys_sharing, ciphertext_sharing, plaintext_eq_sharing);
+	end = my_gettimeofday();
+	aes_sharing_dec_eq = end - start;
+	
 	
-	/*************************** Verifying that sharing AES decryption gives back the original plaintext ***************************/
+	/*************************** Verifying the sharing AES against the reference and the original plaintext ***************************/
 	for(i=0; i<AES_BLOCK_SIZE; i++){
+		if(compress_n_sharing(ciphertext_sharing[i]) != ciphertext[i]){
+			printf("ENCRYPT ERROR\n");
+			exit(EXIT_FAILURE);
+		}
 		if(compress_n_sharing(plaintext_sharing[i]) != compress_n_sharing(plaintext_res_sharing[i])){
 			printf("DECRYPT ERROR\n");
 			exit(EXIT_FAILURE);
 		}
+		if(compress_n_sharing(plaintext_sharing[i]) != compress_n_sharing(plaintext_eq_sharing[i])){
+			printf("EQUIVALENT INVERSE CIPHER DECRYPT ERROR\n");
+			exit(EXIT_FAILURE);
+		}
 	}
 	printf("SHARING ENCRYPTION SUCCESS\n");
 
@@ -137,19 +180,24 @@ int main(int argc, char ** argv){
 	
 	printf("\n\nTimings: \n");
 	
-	printf("\n\nAES sharing enc took %lf ms\n", aes_sharing_enc * 1000);
-	printf("\nAES sharing dec took %lf ms\n", aes_sharing_dec * 1000);
+	printf("\n\nAES enc took %lf ms\n", aes_enc * 1000);
+	printf("\nAES dec took %lf ms\n", aes_dec * 1000);
+	printf("\n\nAES sharing enc took %lf ms (x %.0lf)\n", aes_sharing_enc * 1000, aes_sharing_enc / aes_enc);
+	printf("\nAES sharing dec took %lf ms (x %.0lf)\n", aes_sharing_dec * 1000, aes_sharing_dec / aes_dec);
+	printf("\nAES sharing dec (equivalent inverse cipher) took %lf ms (x %.0lf)\n", aes_sharing_dec_eq * 1000, aes_sharing_dec_eq / aes_dec);
 
-	for(i =0; i< AES_BLOCK_SIZE; i++){
-		free(plaintext_sharing[i]);
-		free(ciphertext_sharing[i]);
-	}
-	for(i=0; i<AES_ROUND_KEY_SIZE; i++){
-		free(roundkeys_sharing[i]);
-	}
+	free(plaintext_shares);
+	free(plaintext_res_shares);
+	free(plaintext_eq_shares);
+	free(ciphertext_shares);
+	free(roundkeys_shares);
+	free(inv_roundkeys_shares);
 	free(plaintext_sharing);
+	free(plaintext_res_sharing);
+	free(plaintext_eq_sharing);
 	free(ciphertext_sharing);
 	free(roundkeys_sharing);
+	free(inv_roundkeys_sharing);
 	
 	return 0;
 	